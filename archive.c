@@ -0,0 +1,245 @@
+#include <dirent.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "archive.h"
+#include "record.h"
+#include "segment.h"
+
+#define RECORD_EXTENSION ".hanoi-puzzle"
+#define SEGMENT_EXTENSION ".hanoi-segment"
+
+static bool
+has_extension (const char *name, const char *extension)
+{
+  const size_t len = strlen (name);
+  const size_t extension_len = strlen (extension);
+
+  return len > extension_len && strcmp (name + len - extension_len, extension) == 0;
+}
+
+static bool
+push_game (struct hanoi_archive *archive, const uint32_t game)
+{
+  if (archive->n_games == archive->games_cap)
+    {
+      const size_t cap = archive->games_cap > 0 ? 2 * archive->games_cap : 1024;
+      struct hanoi_archive_game *games = realloc (archive->games, cap * sizeof (games[0]));
+
+      if (games == NULL)
+        {
+          return false;
+        }
+      archive->games = games;
+      archive->games_cap = cap;
+    }
+
+  archive->games[archive->n_games++]
+      = (struct hanoi_archive_game){ .source = archive->n_sources, .game = game };
+
+  return true;
+}
+
+/**
+ * @brief Adds a record file or a segment and its games. Other files are skipped.
+ */
+static bool
+add_source (struct hanoi_archive *archive, const char *path)
+{
+  const bool is_segment = has_extension (path, SEGMENT_EXTENSION);
+
+  if (!is_segment && !has_extension (path, RECORD_EXTENSION))
+    {
+      return true;
+    }
+
+  if (archive->n_sources == archive->sources_cap)
+    {
+      const size_t cap = archive->sources_cap > 0 ? 2 * archive->sources_cap : 64;
+      struct hanoi_archive_source *sources = realloc (archive->sources, cap * sizeof (sources[0]));
+
+      if (sources == NULL)
+        {
+          return false;
+        }
+      archive->sources = sources;
+      archive->sources_cap = cap;
+    }
+
+  struct hanoi_archive_source *source = &archive->sources[archive->n_sources];
+  const size_t n_games = archive->n_games;
+  bool ok = true;
+
+  source->path = strdup (path);
+  source->is_segment = is_segment;
+
+  if (source->path == NULL)
+    {
+      return false;
+    }
+
+  if (is_segment)
+    {
+      if (!hanoi_segment_open (&source->segment, path))
+        {
+          free (source->path);
+          return false;
+        }
+
+      for (size_t i = 0; ok && i < source->segment.n_entries; ++i)
+        {
+          ok = push_game (archive, i);
+        }
+    }
+  else
+    {
+      ok = push_game (archive, HANOI_ARCHIVE_WHOLE_FILE);
+    }
+
+  if (!ok)
+    {
+      if (is_segment)
+        {
+          hanoi_segment_close (&source->segment);
+        }
+      free (source->path);
+      archive->n_games = n_games;
+      return false;
+    }
+
+  ++archive->n_sources;
+
+  return true;
+}
+
+static bool
+add_directory (struct hanoi_archive *archive, const char *directory)
+{
+  DIR *dir = opendir (directory);
+  if (dir == NULL)
+    {
+      return false;
+    }
+
+  bool ok = true;
+
+  for (struct dirent *dirent; ok && (dirent = readdir (dir)) != NULL;)
+    {
+      const size_t len = strlen (directory) + 1 + strlen (dirent->d_name) + 1;
+      char *path = malloc (len);
+
+      if (path == NULL)
+        {
+          ok = false;
+          break;
+        }
+
+      snprintf (path, len, "%s/%s", directory, dirent->d_name);
+      ok = add_source (archive, path);
+      free (path);
+    }
+
+  const int error = errno;
+  closedir (dir);
+  errno = error;
+
+  return ok;
+}
+
+/**
+ * @brief Adds the games of a `.hanoi-puzzle` record file, of a `.hanoi-segment` or of every such
+ * file in a records directory. Records are only found here, they are read by
+ * `hanoi_archive_record`. An archive must be freed using `hanoi_archive_free`, even if adding
+ * failed.
+ *
+ * @param archive
+ * @param path
+ * @return true - The games were added. Files of other kinds are skipped.
+ * @return false - `path` or a segment in it could not be opened. Check `errno`.
+ */
+bool
+hanoi_archive_add (struct hanoi_archive *archive, const char *path)
+{
+  struct stat st;
+
+  if (stat (path, &st) == -1)
+    {
+      return false;
+    }
+
+  return S_ISDIR (st.st_mode) ? add_directory (archive, path) : add_source (archive, path);
+}
+
+void
+hanoi_archive_free (struct hanoi_archive *archive)
+{
+  for (size_t i = 0; i < archive->n_sources; ++i)
+    {
+      if (archive->sources[i].is_segment)
+        {
+          hanoi_segment_close (&archive->sources[i].segment);
+        }
+      free (archive->sources[i].path);
+    }
+  free (archive->sources);
+  free (archive->games);
+}
+
+/**
+ * @brief Opens game `i` of an archive. A record file is mapped, a game in a segment is viewed in
+ * place. Games of different threads may be open at the same time. A successfull open must be
+ * closed using `hanoi_archive_record_close`.
+ *
+ * @param archive
+ * @param i Index of the game, less than `archive->n_games`.
+ * @param record Target `struct hanoi_archive_record`.
+ * @return true - `record->record` is a view over the game.
+ * @return false - The file is not a record or the index entry does not point at one.
+ */
+bool
+hanoi_archive_record (const struct hanoi_archive *archive, const size_t i,
+                      struct hanoi_archive_record *record)
+{
+  const struct hanoi_archive_game *game = &archive->games[i];
+  const struct hanoi_archive_source *source = &archive->sources[game->source];
+
+  record->is_file = game->game == HANOI_ARCHIVE_WHOLE_FILE;
+
+  if (record->is_file)
+    {
+      if (!hanoi_record_open (&record->file, source->path))
+        {
+          return false;
+        }
+
+      record->record = record->file.record;
+      record->size = record->file.map_len;
+
+      return true;
+    }
+
+  if (!hanoi_segment_record (&source->segment, game->game, &record->record))
+    {
+      errno = EINVAL;
+      return false;
+    }
+
+  record->size = source->segment.entries[game->game].size;
+
+  return true;
+}
+
+void
+hanoi_archive_record_close (struct hanoi_archive_record *record)
+{
+  if (record->is_file)
+    {
+      hanoi_record_close (&record->file);
+    }
+}
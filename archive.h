@@ -0,0 +1,72 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "record.h"
+#include "segment.h"
+
+/* Marks a game as a whole record file instead of a game in a segment. */
+#define HANOI_ARCHIVE_WHOLE_FILE UINT32_MAX
+
+/**
+ * Record file or segment found by `hanoi_archive_add`. Segments are mapped up front so their
+ * games can be read by different threads.
+ */
+struct hanoi_archive_source
+{
+  char *path;
+  bool is_segment;
+  struct hanoi_segment segment;
+};
+
+struct hanoi_archive_game
+{
+  uint32_t source;
+  /* Index of the game in its segment, or `HANOI_ARCHIVE_WHOLE_FILE`. */
+  uint32_t game;
+};
+
+/**
+ * Every game of a set of record files, segments and records directories. Zero initialize before
+ * the first `hanoi_archive_add`.
+ */
+struct hanoi_archive
+{
+  struct hanoi_archive_source *sources;
+  size_t n_sources;
+  size_t sources_cap;
+  struct hanoi_archive_game *games;
+  size_t n_games;
+  size_t games_cap;
+};
+
+/**
+ * Game of an archive opened by `hanoi_archive_record`.
+ */
+struct hanoi_archive_record
+{
+  struct hanoi_record record;
+  /* Bytes the game takes up, the whole file for a record file. */
+  size_t size;
+  /* Mapping of a record file, unused for a game in a segment. */
+  struct hanoi_record_file file;
+  bool is_file;
+};
+
+bool
+hanoi_archive_add (struct hanoi_archive *archive, const char *path);
+
+void
+hanoi_archive_free (struct hanoi_archive *archive);
+
+bool
+hanoi_archive_record (const struct hanoi_archive *archive, const size_t i,
+                      struct hanoi_archive_record *record);
+
+void
+hanoi_archive_record_close (struct hanoi_archive_record *record);
+
+#endif /* ARCHIVE_H */
\ No newline at end of file
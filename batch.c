@@ -0,0 +1,288 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#define HANOI_BATCH_X86
+#endif
+
+#include "batch.h"
+#include "bitboard.h"
+#include "hanoi.h"
+
+/**
+ * @brief Initializes a `struct hanoi_batch` where every puzzle has all disks on the first rod. A
+ * succsessfull init must be freed using `hanoi_batch_free`.
+ *
+ * @param batch Target `struct hanoi_batch`.
+ * @param n_rods Amount of rods in every puzzle. At most `HANOI_BITBOARD_MAX_RODS`.
+ * @param n_disks Amount of disks in every puzzle. At most `HANOI_BITBOARD_MAX_DISKS`.
+ * @param n_puzzles Amount of puzzles. Less than `UINT32_MAX`.
+ * @return HANOI_INIT_OK - Init successful.
+ * @return HANOI_INIT_INVALID_N_RODS_VALUE - The value of `n_rods` was set to `HANOI_INCOMPLATE`.
+ * @return HANOI_INIT_UNSUPPORTED_SIZE - Too many rods, disks or puzzles.
+ * @return HANOI_INIT_SYSTEM_ERROR - System failure during init. Check `errno`.
+ */
+enum hanoi_init_response
+hanoi_batch_init (struct hanoi_batch *batch, const uint32_t n_rods, const uint32_t n_disks,
+                  const size_t n_puzzles)
+{
+  struct hanoi_bitboard bb;
+
+  const enum hanoi_init_response response = hanoi_bitboard_init (&bb, n_rods, n_disks);
+  if (response != HANOI_INIT_OK)
+    {
+      return response;
+    }
+
+  /* The kernels compute indices with 32 bit multiplies. */
+  if (n_puzzles >= UINT32_MAX - HANOI_BATCH_ALIGNMENT)
+    {
+      return HANOI_INIT_UNSUPPORTED_SIZE;
+    }
+
+  /* Every rod starts on a cache line of its own. */
+  const size_t per_line = HANOI_BATCH_ALIGNMENT / sizeof (uint64_t);
+  const size_t stride = (n_puzzles + per_line - 1) / per_line * per_line;
+  const size_t size = sizeof (uint64_t) * stride * (n_rods > 0 ? n_rods : 1);
+
+  batch->rods = aligned_alloc (HANOI_BATCH_ALIGNMENT, size > 0 ? size : HANOI_BATCH_ALIGNMENT);
+  if (batch->rods == NULL)
+    {
+      return HANOI_INIT_SYSTEM_ERROR;
+    }
+
+  memset (batch->rods, 0, size);
+
+  batch->n_rods = n_rods;
+  batch->n_disks = n_disks;
+  batch->n_puzzles = n_puzzles;
+  batch->stride = stride;
+
+  for (size_t k = 0; k < n_puzzles; ++k)
+    {
+      hanoi_batch_set (batch, k, &bb);
+    }
+
+  return HANOI_INIT_OK;
+}
+
+void
+hanoi_batch_free (struct hanoi_batch *batch)
+{
+  free (batch->rods);
+}
+
+/**
+ * @brief Replaces the state of one puzzle in the batch.
+ *
+ * @param batch
+ * @param k Index of the puzzle.
+ * @param bb Bitboard of the same size as the puzzles in `batch`.
+ */
+void
+hanoi_batch_set (struct hanoi_batch *batch, const size_t k, const struct hanoi_bitboard *bb)
+{
+  for (uint32_t i = 0; i < batch->n_rods; ++i)
+    {
+      batch->rods[i * batch->stride + k] = bb->rods[i];
+    }
+}
+
+/**
+ * @brief Copies the state of one puzzle in the batch into a bitboard.
+ *
+ * @param batch
+ * @param k Index of the puzzle.
+ * @param bb Target `struct hanoi_bitboard`.
+ */
+void
+hanoi_batch_get (const struct hanoi_batch *batch, const size_t k, struct hanoi_bitboard *bb)
+{
+  hanoi_bitboard_init (bb, batch->n_rods, batch->n_disks);
+
+  for (uint32_t i = 0; i < batch->n_rods; ++i)
+    {
+      bb->rods[i] = batch->rods[i * batch->stride + k];
+    }
+}
+
+/**
+ * @brief Applies moves to the puzzles in `[begin, end)` without branching on their outcome. See
+ * `hanoi_bitboard_move` for how a single compare validates the move.
+ *
+ * @return uint64_t - Bit `k - begin` is set if the move of puzzle `k` was made.
+ */
+static uint64_t
+move_scalar (uint64_t *rods, const size_t stride, const size_t begin, const size_t end,
+             const uint32_t *src_i, const uint32_t *des_i)
+{
+  uint64_t bits = 0;
+
+  for (size_t k = begin; k < end; ++k)
+    {
+      uint64_t *src_rod = rods + src_i[k] * stride + k;
+      uint64_t *des_rod = rods + des_i[k] * stride + k;
+
+      const uint64_t src = *src_rod & -*src_rod;
+      const uint64_t des = *des_rod & -*des_rod;
+      const uint64_t ok = src - 1 < des - 1;
+      const uint64_t disk = src & -ok;
+
+      *src_rod ^= disk;
+      *des_rod |= disk;
+      bits |= ok << (k - begin);
+    }
+
+  return bits;
+}
+
+#ifdef HANOI_BATCH_X86
+
+/* There are only signed 64 bit compares, flipping the sign bit turns them into unsigned ones. */
+#define SIGN_BIT ((long long)0x8000000000000000ULL)
+
+__attribute__ ((target ("avx2"))) static uint64_t
+move_avx2 (uint64_t *rods, const size_t stride, const size_t begin, const size_t end,
+           const uint32_t *src_i, const uint32_t *des_i)
+{
+  const __m256i one = _mm256_set1_epi64x (1);
+  const __m256i sign = _mm256_set1_epi64x (SIGN_BIT);
+  const __m256i zero = _mm256_setzero_si256 ();
+  const __m256i vstride = _mm256_set1_epi64x ((long long)stride);
+
+  uint64_t bits = 0;
+  size_t k = begin;
+
+  for (; k + 4 <= end; k += 4)
+    {
+      const __m256i lane = _mm256_add_epi64 (_mm256_set1_epi64x ((long long)k),
+                                             _mm256_set_epi64x (3, 2, 1, 0));
+      const __m256i si = _mm256_cvtepu32_epi64 (_mm_loadu_si128 ((const __m128i *)(src_i + k)));
+      const __m256i di = _mm256_cvtepu32_epi64 (_mm_loadu_si128 ((const __m128i *)(des_i + k)));
+      const __m256i src_idx = _mm256_add_epi64 (_mm256_mul_epu32 (si, vstride), lane);
+      const __m256i des_idx = _mm256_add_epi64 (_mm256_mul_epu32 (di, vstride), lane);
+
+      const __m256i src_rod = _mm256_i64gather_epi64 ((const long long *)rods, src_idx, 8);
+      const __m256i des_rod = _mm256_i64gather_epi64 ((const long long *)rods, des_idx, 8);
+      const __m256i src = _mm256_and_si256 (src_rod, _mm256_sub_epi64 (zero, src_rod));
+      const __m256i des = _mm256_and_si256 (des_rod, _mm256_sub_epi64 (zero, des_rod));
+
+      const __m256i ok = _mm256_cmpgt_epi64 (_mm256_xor_si256 (_mm256_sub_epi64 (des, one), sign),
+                                             _mm256_xor_si256 (_mm256_sub_epi64 (src, one), sign));
+      const __m256i disk = _mm256_and_si256 (src, ok);
+
+      /* There is no scatter, but each lane is a different puzzle so the stores never overlap. */
+      uint64_t s[4], d[4], m[4];
+      _mm256_storeu_si256 ((__m256i *)s, src_idx);
+      _mm256_storeu_si256 ((__m256i *)d, des_idx);
+      _mm256_storeu_si256 ((__m256i *)m, disk);
+
+      for (uint32_t j = 0; j < 4; ++j)
+        {
+          rods[s[j]] ^= m[j];
+          rods[d[j]] |= m[j];
+        }
+
+      bits |= (uint64_t)_mm256_movemask_pd (_mm256_castsi256_pd (ok)) << (k - begin);
+    }
+
+  if (k < end)
+    {
+      bits |= move_scalar (rods, stride, k, end, src_i, des_i) << (k - begin);
+    }
+
+  return bits;
+}
+
+__attribute__ ((target ("sse4.2"))) static uint64_t
+move_sse42 (uint64_t *rods, const size_t stride, const size_t begin, const size_t end,
+            const uint32_t *src_i, const uint32_t *des_i)
+{
+  const __m128i one = _mm_set1_epi64x (1);
+  const __m128i sign = _mm_set1_epi64x (SIGN_BIT);
+  const __m128i zero = _mm_setzero_si128 ();
+
+  uint64_t bits = 0;
+  size_t k = begin;
+
+  for (; k + 2 <= end; k += 2)
+    {
+      uint64_t *s0 = rods + src_i[k] * stride + k;
+      uint64_t *s1 = rods + src_i[k + 1] * stride + k + 1;
+      uint64_t *d0 = rods + des_i[k] * stride + k;
+      uint64_t *d1 = rods + des_i[k + 1] * stride + k + 1;
+
+      const __m128i src_rod = _mm_set_epi64x ((long long)*s1, (long long)*s0);
+      const __m128i des_rod = _mm_set_epi64x ((long long)*d1, (long long)*d0);
+      const __m128i src = _mm_and_si128 (src_rod, _mm_sub_epi64 (zero, src_rod));
+      const __m128i des = _mm_and_si128 (des_rod, _mm_sub_epi64 (zero, des_rod));
+
+      const __m128i ok = _mm_cmpgt_epi64 (_mm_xor_si128 (_mm_sub_epi64 (des, one), sign),
+                                          _mm_xor_si128 (_mm_sub_epi64 (src, one), sign));
+      const __m128i disk = _mm_and_si128 (src, ok);
+
+      const uint64_t m0 = (uint64_t)_mm_cvtsi128_si64 (disk);
+      const uint64_t m1 = (uint64_t)_mm_extract_epi64 (disk, 1);
+      *s0 ^= m0;
+      *d0 |= m0;
+      *s1 ^= m1;
+      *d1 |= m1;
+
+      bits |= (uint64_t)_mm_movemask_pd (_mm_castsi128_pd (ok)) << (k - begin);
+    }
+
+  if (k < end)
+    {
+      bits |= move_scalar (rods, stride, k, end, src_i, des_i) << (k - begin);
+    }
+
+  return bits;
+}
+
+#endif /* HANOI_BATCH_X86 */
+
+/**
+ * @brief Makes one move in every puzzle of the batch. Same rules as `hanoi_move`; a move that is
+ * not allowed leaves its puzzle as it was. Uses AVX2 or SSE4.2 when the CPU has them.
+ *
+ * @param batch
+ * @param src_i Index of the source rod for each puzzle. Every index must be less than `n_rods`.
+ * @param des_i Index of the destination rod for each puzzle. Every index must be less than
+ * `n_rods`.
+ * @param success Bit `k % 64` of `success[k / 64]` is set if the move of puzzle `k` was made.
+ * Holds `(n_puzzles + 63) / 64` words.
+ * @return size_t - Amount of moves that were made.
+ */
+size_t
+hanoi_batch_move (struct hanoi_batch *batch, const uint32_t *src_i, const uint32_t *des_i,
+                  uint64_t *success)
+{
+  uint64_t (*kernel) (uint64_t *, const size_t, const size_t, const size_t, const uint32_t *,
+                      const uint32_t *)
+      = move_scalar;
+
+#ifdef HANOI_BATCH_X86
+  if (__builtin_cpu_supports ("avx2"))
+    {
+      kernel = move_avx2;
+    }
+  else if (__builtin_cpu_supports ("sse4.2"))
+    {
+      kernel = move_sse42;
+    }
+#endif
+
+  size_t n_moves = 0;
+
+  for (size_t k = 0; k < batch->n_puzzles; k += 64)
+    {
+      const size_t end = k + 64 < batch->n_puzzles ? k + 64 : batch->n_puzzles;
+      success[k / 64] = kernel (batch->rods, batch->stride, k, end, src_i, des_i);
+      n_moves += __builtin_popcountll (success[k / 64]);
+    }
+
+  return n_moves;
+}
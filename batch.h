@@ -0,0 +1,44 @@
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitboard.h"
+#include "hanoi.h"
+
+#define HANOI_BATCH_ALIGNMENT 64
+
+/**
+ * Many puzzles of the same size stored as bitboards, structure of arrays style. The mask of rod `i`
+ * in puzzle `k` is `rods[i * stride + k]`, so the same rod of neighbouring puzzles is contiguous
+ * and a move can be applied to several puzzles with one vector instruction.
+ */
+struct hanoi_batch
+{
+  uint32_t n_rods;
+  uint32_t n_disks;
+  size_t n_puzzles;
+  size_t stride;
+  uint64_t *rods;
+};
+
+enum hanoi_init_response
+hanoi_batch_init (struct hanoi_batch *batch, const uint32_t n_rods, const uint32_t n_disks,
+                  const size_t n_puzzles);
+
+void
+hanoi_batch_free (struct hanoi_batch *batch);
+
+void
+hanoi_batch_set (struct hanoi_batch *batch, const size_t k, const struct hanoi_bitboard *bb);
+
+void
+hanoi_batch_get (const struct hanoi_batch *batch, const size_t k, struct hanoi_bitboard *bb);
+
+size_t
+hanoi_batch_move (struct hanoi_batch *batch, const uint32_t *src_i, const uint32_t *des_i,
+                  uint64_t *success);
+
+#endif /* BATCH_H */
\ No newline at end of file
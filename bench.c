@@ -0,0 +1,603 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fixed.h"
+#include "hanoi.h"
+#include "leaderboard.h"
+#include "record.h"
+#include "solve.h"
+
+#define error(...)                                                                                 \
+  {                                                                                                \
+    fprintf (stderr, "ERROR %s:%d - ", __FILE__, __LINE__);                                        \
+    fprintf (stderr, __VA_ARGS__);                                                                 \
+  }
+
+/* Every benchmark takes this many samples after as many warmup samples. */
+#define N_SAMPLES 1000
+#define N_WARMUP 100
+#define LONG_LOG_MOVES 1000000
+
+/**
+ * Timings of one benchmark. Fast operations are timed in batches so the clock is not what is
+ * measured, and every sample is the time of a whole batch.
+ */
+struct bench
+{
+  const char *name;
+  uint32_t n_rods;
+  uint32_t n_disks;
+  const char *storage;
+  uint64_t batch;
+  uint64_t samples[N_SAMPLES];
+  uint32_t n_samples;
+  uint64_t total_ns;
+  uint64_t n_ops;
+};
+
+static bool first_result = true;
+
+static uint64_t
+now_ns (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+bench_init (struct bench *bench, const char *name, const uint32_t n_rods, const uint32_t n_disks,
+            const uint64_t batch)
+{
+  bench->name = name;
+  bench->n_rods = n_rods;
+  bench->n_disks = n_disks;
+  bench->storage = NULL;
+  bench->batch = batch;
+  bench->n_samples = 0;
+  bench->total_ns = 0;
+  bench->n_ops = 0;
+}
+
+static void
+bench_sample (struct bench *bench, const uint64_t start, const uint64_t stop)
+{
+  bench->total_ns += stop - start;
+  bench->n_ops += bench->batch;
+  bench->samples[bench->n_samples++] = stop - start;
+}
+
+static int
+compare_u64 (const void *a, const void *b)
+{
+  const uint64_t x = *(const uint64_t *)a;
+  const uint64_t y = *(const uint64_t *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief Time per operation of the batch at percentile `p`, in ns.
+ */
+static double
+percentile (const struct bench *bench, const uint32_t p)
+{
+  return (double)bench->samples[(uint64_t)(bench->n_samples - 1) * p / 100] / bench->batch;
+}
+
+/**
+ * @brief Prints the result of a benchmark as an element of the JSON array on stdout.
+ */
+static void
+bench_report (struct bench *bench)
+{
+  qsort (bench->samples, bench->n_samples, sizeof (bench->samples[0]), compare_u64);
+
+  const double ns_per_op = (double)bench->total_ns / bench->n_ops;
+
+  printf ("%s\n    {\"name\": \"%s\", \"n_rods\": %u, \"n_disks\": %u, ", first_result ? "" : ",",
+          bench->name, bench->n_rods, bench->n_disks);
+  if (bench->storage != NULL)
+    {
+      printf ("\"storage\": \"%s\", ", bench->storage);
+    }
+  printf ("\"ops\": %lu, \"ns_per_op\": %.2f, \"ops_per_s\": %.0f, ", (unsigned long)bench->n_ops,
+          ns_per_op, 1e9 / ns_per_op);
+  printf ("\"p50_ns\": %.2f", percentile (bench, 50));
+
+  /* A percentile is only reported when there are enough samples above it to tell it from the
+     maximum. */
+  if (bench->n_samples >= 10)
+    {
+      printf (", \"p90_ns\": %.2f", percentile (bench, 90));
+    }
+  if (bench->n_samples >= 100)
+    {
+      printf (", \"p99_ns\": %.2f", percentile (bench, 99));
+    }
+  printf ("}");
+  fflush (stdout);
+
+  first_result = false;
+}
+
+static bool
+bench_init_free (const uint32_t n_rods, const uint32_t n_disks)
+{
+  struct bench bench;
+  bench_init (&bench, "hanoi_init_free", n_rods, n_disks, 100);
+
+  for (uint32_t s = 0; s < N_WARMUP + N_SAMPLES; ++s)
+    {
+      const uint64_t start = now_ns ();
+
+      for (uint64_t i = 0; i < bench.batch; ++i)
+        {
+          struct hanoi_puzzle pzl;
+
+          if (hanoi_init (&pzl, n_rods, n_disks) != HANOI_INIT_OK)
+            {
+              return false;
+            }
+          hanoi_free (&pzl);
+        }
+
+      if (s >= N_WARMUP)
+        {
+          bench_sample (&bench, start, now_ns ());
+        }
+    }
+
+  bench_report (&bench);
+
+  return true;
+}
+
+/**
+ * @brief Makes the optimal solution of a puzzle, followed by the same moves backwards so the
+ * sequence can be applied over and over.
+ */
+static struct hanoi_move *
+round_trip (const uint32_t n_rods, const uint32_t n_disks, uint64_t *n_moves)
+{
+  struct hanoi_solve_table table;
+  if (hanoi_solve_table_init (&table, n_rods, n_disks) != HANOI_INIT_OK)
+    {
+      return NULL;
+    }
+
+  const uint64_t n = hanoi_solve_table_n_moves (&table);
+  struct hanoi_move *moves = malloc (2 * n * sizeof (moves[0]));
+
+  if (moves != NULL)
+    {
+      for (uint64_t k = 0; k < n; ++k)
+        {
+          moves[k] = hanoi_solve_table_move (&table, k);
+          moves[2 * n - 1 - k].src_i = moves[k].des_i;
+          moves[2 * n - 1 - k].des_i = moves[k].src_i;
+        }
+      *n_moves = 2 * n;
+    }
+
+  hanoi_solve_table_free (&table);
+
+  return moves;
+}
+
+static bool
+bench_move (const uint32_t n_rods, const uint32_t n_disks)
+{
+  uint64_t n_moves;
+  struct hanoi_move *moves = round_trip (n_rods, n_disks, &n_moves);
+  struct hanoi_puzzle pzl;
+
+  if (moves == NULL)
+    {
+      return false;
+    }
+  if (hanoi_init (&pzl, n_rods, n_disks) != HANOI_INIT_OK)
+    {
+      free (moves);
+      return false;
+    }
+
+  struct bench bench;
+  bench_init (&bench, "hanoi_move", n_rods, n_disks, 1000);
+
+  uint64_t k = 0;
+  bool ok = true;
+
+  for (uint32_t s = 0; ok && s < N_WARMUP + N_SAMPLES; ++s)
+    {
+      const uint64_t start = now_ns ();
+
+      for (uint64_t i = 0; i < bench.batch; ++i)
+        {
+          ok &= hanoi_move (&pzl, moves[k].src_i, moves[k].des_i);
+          k = k + 1 < n_moves ? k + 1 : 0;
+        }
+
+      if (s >= N_WARMUP)
+        {
+          bench_sample (&bench, start, now_ns ());
+        }
+    }
+
+  if (ok)
+    {
+      bench_report (&bench);
+    }
+  else
+    {
+      errno = EINVAL;
+    }
+
+  hanoi_free (&pzl);
+  free (moves);
+
+  return ok;
+}
+
+/**
+ * Defines `bench_fixed_move_RxD`, `bench_move` for the `struct hanoi_fixed_RxD` of fixed.h. The
+ * round trip is also played on a generic puzzle once and both must end up alike.
+ */
+#define BENCH_FIXED_MOVE(R, D)                                                                    \
+  static bool bench_fixed_move_##R##x##D (void)                                                   \
+  {                                                                                               \
+    uint64_t n_moves;                                                                             \
+    struct hanoi_move *moves = round_trip (R, D, &n_moves);                                       \
+    struct hanoi_puzzle pzl;                                                                      \
+    struct hanoi_fixed_##R##x##D fx;                                                              \
+                                                                                                  \
+    if (moves == NULL)                                                                            \
+      {                                                                                           \
+        return false;                                                                             \
+      }                                                                                           \
+    if (hanoi_init (&pzl, R, D) != HANOI_INIT_OK)                                                 \
+      {                                                                                           \
+        free (moves);                                                                             \
+        return false;                                                                             \
+      }                                                                                           \
+                                                                                                  \
+    bool ok = hanoi_fixed_##R##x##D##_from_puzzle (&fx, &pzl);                                    \
+                                                                                                  \
+    for (uint64_t k = 0; ok && k < n_moves / 2; ++k)                                              \
+      {                                                                                           \
+        ok = hanoi_fixed_##R##x##D##_move (&fx, moves[k].src_i, moves[k].des_i)                   \
+             && hanoi_move (&pzl, moves[k].src_i, moves[k].des_i)                                 \
+             && hanoi_fixed_##R##x##D##_top_disk (&fx, moves[k].des_i)                            \
+                    == hanoi_top_disk (&pzl, moves[k].des_i)                                      \
+             && hanoi_fixed_##R##x##D##_complete (&fx) == hanoi_complete (&pzl);                  \
+      }                                                                                           \
+    ok = ok && hanoi_fixed_##R##x##D##_empty_rod (&fx, 0) && hanoi_empty_rod (&pzl, 0);           \
+                                                                                                  \
+    hanoi_fixed_##R##x##D##_init (&fx);                                                           \
+    hanoi_fixed_##R##x##D##_to_puzzle (&fx, &pzl);                                                \
+    ok = ok && hanoi_complete (&pzl) == 0;                                                        \
+                                                                                                  \
+    struct bench bench;                                                                           \
+    bench_init (&bench, "hanoi_fixed_move", R, D, 1000);                                          \
+                                                                                                  \
+    uint64_t k = 0;                                                                               \
+                                                                                                  \
+    for (uint32_t s = 0; ok && s < N_WARMUP + N_SAMPLES; ++s)                                     \
+      {                                                                                           \
+        const uint64_t start = now_ns ();                                                         \
+                                                                                                  \
+        for (uint64_t i = 0; i < bench.batch; ++i)                                                \
+          {                                                                                       \
+            ok &= hanoi_fixed_##R##x##D##_move (&fx, moves[k].src_i, moves[k].des_i);             \
+            k = k + 1 < n_moves ? k + 1 : 0;                                                      \
+          }                                                                                       \
+                                                                                                  \
+        if (s >= N_WARMUP)                                                                        \
+          {                                                                                       \
+            bench_sample (&bench, start, now_ns ());                                              \
+          }                                                                                       \
+      }                                                                                           \
+                                                                                                  \
+    if (ok)                                                                                       \
+      {                                                                                           \
+        bench_report (&bench);                                                                    \
+      }                                                                                           \
+    else                                                                                          \
+      {                                                                                           \
+        errno = EINVAL;                                                                           \
+      }                                                                                           \
+                                                                                                  \
+    hanoi_free (&pzl);                                                                            \
+    free (moves);                                                                                 \
+                                                                                                  \
+    return ok;                                                                                    \
+  }
+
+BENCH_FIXED_MOVE (3, 4)
+BENCH_FIXED_MOVE (3, 8)
+BENCH_FIXED_MOVE (4, 10)
+
+static bool
+bench_complete (const uint32_t n_rods, const uint32_t n_disks, const bool complete)
+{
+  struct hanoi_puzzle pzl;
+  if (hanoi_init (&pzl, n_rods, n_disks) != HANOI_INIT_OK)
+    {
+      return false;
+    }
+
+  /* Moving the smallest disk away leaves no rod complete. */
+  if (!complete)
+    {
+      hanoi_move (&pzl, 0, 1);
+    }
+
+  struct bench bench;
+  bench_init (&bench, complete ? "hanoi_complete" : "hanoi_complete_incomplete", n_rods, n_disks,
+              1000);
+
+  volatile uint32_t sink = 0;
+
+  for (uint32_t s = 0; s < N_WARMUP + N_SAMPLES; ++s)
+    {
+      const uint64_t start = now_ns ();
+
+      for (uint64_t i = 0; i < bench.batch; ++i)
+        {
+          sink = hanoi_complete (&pzl);
+        }
+
+      if (s >= N_WARMUP)
+        {
+          bench_sample (&bench, start, now_ns ());
+        }
+    }
+  (void)sink;
+
+  bench_report (&bench);
+  hanoi_free (&pzl);
+
+  return true;
+}
+
+/**
+ * @brief Times `hanoi_recorder_push_move` one move at a time, over the moves of a round trip.
+ */
+static bool
+bench_push_move (const char *storage, const uint32_t n_rods, const uint32_t n_disks)
+{
+  uint64_t n_moves;
+  struct hanoi_move *moves = round_trip (n_rods, n_disks, &n_moves);
+  struct hanoi_puzzle pzl;
+  struct hanoi_recorder recorder;
+
+  if (moves == NULL)
+    {
+      return false;
+    }
+  if (hanoi_init (&pzl, n_rods, n_disks) != HANOI_INIT_OK)
+    {
+      free (moves);
+      return false;
+    }
+  if (!hanoi_new_recorder (&recorder, &pzl, "bench"))
+    {
+      hanoi_free (&pzl);
+      free (moves);
+      return false;
+    }
+
+  struct bench bench;
+  bench_init (&bench, "hanoi_recorder_push_move", n_rods, n_disks, 1);
+  bench.storage = storage;
+
+  bool ok = true;
+
+  for (uint32_t s = 0; ok && s < 10 * (N_WARMUP + N_SAMPLES); ++s)
+    {
+      const struct hanoi_move *move = &moves[s % n_moves];
+      const uint64_t start = now_ns ();
+
+      ok = hanoi_recorder_push_move (&recorder, move->src_i, move->des_i, s);
+
+      /* Only every tenth move is kept so a long run fits the samples. */
+      if (s >= 10 * N_WARMUP && s % 10 == 0)
+        {
+          bench_sample (&bench, start, now_ns ());
+        }
+    }
+
+  if (ok)
+    {
+      bench_report (&bench);
+    }
+
+  hanoi_recorder_remove_file (&recorder);
+  hanoi_free_recorder (&recorder);
+  hanoi_free (&pzl);
+  free (moves);
+
+  return ok;
+}
+
+/**
+ * @brief Times `hanoi_recorder_write_checksum` of records with `LONG_LOG_MOVES` moves each.
+ */
+static bool
+bench_write_checksum (const char *storage, const uint32_t n_rods, const uint32_t n_disks,
+                      const uint32_t n_records)
+{
+  uint64_t n_moves;
+  struct hanoi_move *moves = round_trip (n_rods, n_disks, &n_moves);
+  struct hanoi_puzzle pzl;
+
+  if (moves == NULL)
+    {
+      return false;
+    }
+  if (hanoi_init (&pzl, n_rods, n_disks) != HANOI_INIT_OK)
+    {
+      free (moves);
+      return false;
+    }
+
+  struct bench bench;
+  bench_init (&bench, "hanoi_recorder_write_checksum", n_rods, n_disks, 1);
+  bench.storage = storage;
+
+  bool ok = true;
+
+  for (uint32_t r = 0; ok && r < n_records; ++r)
+    {
+      struct hanoi_recorder recorder;
+      if (!hanoi_new_recorder (&recorder, &pzl, "bench"))
+        {
+          ok = false;
+          break;
+        }
+
+      for (uint64_t k = 0; ok && k < LONG_LOG_MOVES; ++k)
+        {
+          ok = hanoi_recorder_push_move (&recorder, moves[k % n_moves].src_i,
+                                         moves[k % n_moves].des_i, k);
+        }
+
+      const uint64_t start = now_ns ();
+      ok = ok && hanoi_recorder_write_checksum (&recorder);
+      bench_sample (&bench, start, now_ns ());
+
+      remove (recorder.path);
+      hanoi_free_recorder (&recorder);
+    }
+
+  if (ok)
+    {
+      bench_report (&bench);
+    }
+
+  hanoi_free (&pzl);
+  free (moves);
+
+  return ok;
+}
+
+/**
+ * @brief Runs the recorder benchmarks with records in a new directory under `parent`.
+ */
+static bool
+bench_recorder (const char *storage, const char *parent)
+{
+  const size_t len = strlen (parent) + strlen ("/hanoi-bench-XXXXXX") + 1;
+  char *directory = malloc (len);
+
+  if (directory == NULL)
+    {
+      return false;
+    }
+
+  snprintf (directory, len, "%s/hanoi-bench-XXXXXX", parent);
+  if (mkdtemp (directory) == NULL)
+    {
+      free (directory);
+      return false;
+    }
+
+  hanoi_set_records_directory (directory);
+
+  const bool ok = bench_push_move (storage, 3, 8) && bench_push_move (storage, 4, 16)
+                  && bench_write_checksum (storage, 3, 16, 5);
+
+  /* The leaderboard is the only file left behind by the benchmarks. */
+  const size_t leaderboard_len = len + 1 + strlen (HANOI_LEADERBOARD_FILENAME);
+  char *leaderboard = malloc (leaderboard_len);
+  if (leaderboard != NULL)
+    {
+      snprintf (leaderboard, leaderboard_len, "%s/%s", directory, HANOI_LEADERBOARD_FILENAME);
+      remove (leaderboard);
+      free (leaderboard);
+    }
+  rmdir (directory);
+  free (directory);
+
+  return ok;
+}
+
+static void
+print_help (const char *program)
+{
+  printf ("usage: %s\n", program);
+  printf ("    [ --tmpfs-dir=<path> ]\n");
+  printf ("    [ --disk-dir=<path> ]\n");
+  printf ("    [ --help ]\n");
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *tmpfs_dir = "/dev/shm";
+  const char *disk_dir = ".";
+
+  for (int i = 1; i < argc; ++i)
+    {
+      if (strncmp (argv[i], "--tmpfs-dir=", strlen ("--tmpfs-dir=")) == 0)
+        {
+          tmpfs_dir = argv[i] + strlen ("--tmpfs-dir=");
+        }
+      else if (strncmp (argv[i], "--disk-dir=", strlen ("--disk-dir=")) == 0)
+        {
+          disk_dir = argv[i] + strlen ("--disk-dir=");
+        }
+      else if (strcmp (argv[i], "--help") == 0)
+        {
+          print_help (argv[0]);
+          return 0;
+        }
+      else
+        {
+          error ("unknown option '%s'\n", argv[i]);
+          print_help (argv[0]);
+          return 1;
+        }
+    }
+
+  static const uint32_t sizes[][2] = { { 3, 8 }, { 3, 16 }, { 4, 16 }, { 5, 32 }, { 8, 64 } };
+  const size_t n_sizes = sizeof (sizes) / sizeof (sizes[0]);
+  bool ok = true;
+
+  printf ("{\"benchmarks\": [");
+
+  for (size_t i = 0; ok && i < n_sizes; ++i)
+    {
+      ok = bench_init_free (sizes[i][0], sizes[i][1]);
+    }
+  for (size_t i = 0; ok && i < n_sizes; ++i)
+    {
+      ok = bench_move (sizes[i][0], sizes[i][1]);
+    }
+  ok = ok && bench_fixed_move_3x4 () && bench_fixed_move_3x8 () && bench_fixed_move_4x10 ();
+  for (size_t i = 0; ok && i < n_sizes; ++i)
+    {
+      ok = bench_complete (sizes[i][0], sizes[i][1], true)
+           && bench_complete (sizes[i][0], sizes[i][1], false);
+    }
+
+  ok = ok && bench_recorder ("tmpfs", tmpfs_dir) && bench_recorder ("disk", disk_dir);
+
+  printf ("\n]}\n");
+
+  if (!ok)
+    {
+      error ("%s\n", strerror (errno));
+      return 1;
+    }
+
+  return 0;
+}
@@ -0,0 +1,175 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bitboard.h"
+#include "hanoi.h"
+
+static uint64_t
+full_mask (const uint32_t n_disks)
+{
+  return n_disks == 64 ? ~(uint64_t)0 : ((uint64_t)1 << n_disks) - 1;
+}
+
+/**
+ * @brief Initializes a `struct hanoi_bitboard` with all disks on the first rod. Unlike `hanoi_init`
+ * nothing is allocated, so there is nothing to free.
+ *
+ * @param bb Target `struct hanoi_bitboard`.
+ * @param n_rods Amount of rods in the puzzle. At most `HANOI_BITBOARD_MAX_RODS`.
+ * @param n_disks Amount of disks in the puzzle. At most `HANOI_BITBOARD_MAX_DISKS`.
+ * @return HANOI_INIT_OK - Init successful.
+ * @return HANOI_INIT_INVALID_N_RODS_VALUE - The value of `n_rods` was set to `HANOI_INCOMPLATE`.
+ * @return HANOI_INIT_UNSUPPORTED_SIZE - Too many rods or disks for a bitboard.
+ */
+enum hanoi_init_response
+hanoi_bitboard_init (struct hanoi_bitboard *bb, const uint32_t n_rods, const uint32_t n_disks)
+{
+  if (n_rods == HANOI_INCOMPLETE)
+    {
+      return HANOI_INIT_INVALID_N_RODS_VALUE;
+    }
+
+  if (n_rods > HANOI_BITBOARD_MAX_RODS || n_disks > HANOI_BITBOARD_MAX_DISKS)
+    {
+      return HANOI_INIT_UNSUPPORTED_SIZE;
+    }
+
+  for (uint32_t i = 0; i < HANOI_BITBOARD_MAX_RODS; ++i)
+    {
+      bb->rods[i] = 0;
+    }
+
+  if (n_rods > 0)
+    {
+      bb->rods[0] = full_mask (n_disks);
+    }
+
+  bb->n_rods = n_rods;
+  bb->n_disks = n_disks;
+
+  return HANOI_INIT_OK;
+}
+
+/**
+ * @brief Moves a disk to a new rod. Same rules as `hanoi_move`.
+ *
+ * @param bb A `struct hanoi_bitboard` where the move should take place.
+ * @param src_i Index of the source rod.
+ * @param des_i Index of the destination rod.
+ * @return true - State was updated.
+ * @return false - State did not update.
+ */
+bool
+hanoi_bitboard_move (struct hanoi_bitboard *bb, const uint32_t src_i, const uint32_t des_i)
+{
+  const uint64_t src = bb->rods[src_i] & -bb->rods[src_i];
+  const uint64_t des = bb->rods[des_i] & -bb->rods[des_i];
+
+  /* Subtracting one makes an empty source the largest value and an empty destination larger than
+     any disk, so a single compare covers both empty rods and disk sizes. Moving a disk onto its own
+     rod compares equal and is rejected. */
+  if (src - 1 < des - 1)
+    {
+      bb->rods[src_i] ^= src;
+      bb->rods[des_i] |= src;
+      return true;
+    }
+
+  return false;
+}
+
+bool
+hanoi_bitboard_empty_rod (const struct hanoi_bitboard *bb, const uint32_t i)
+{
+  return bb->rods[i] == 0;
+}
+
+uint32_t
+hanoi_bitboard_top_disk (const struct hanoi_bitboard *bb, const uint32_t i)
+{
+  return bb->rods[i] == 0 ? 0 : __builtin_ctzll (bb->rods[i]) + 1;
+}
+
+/**
+ * @brief Checks if a `struct hanoi_bitboard` is completed. See `hanoi_complete`.
+ *
+ * @param bb
+ * @return uint32_t The index of the rod where all disks resides or `HANOI_INCOMPLETE` if the puzzle
+ * is not complete.
+ */
+uint32_t
+hanoi_bitboard_complete (const struct hanoi_bitboard *bb)
+{
+  const uint64_t full = full_mask (bb->n_disks);
+
+  for (uint32_t i = 0; i < bb->n_rods; ++i)
+    {
+      if (bb->rods[i] == full && full != 0)
+        {
+          return i;
+        }
+    }
+
+  return HANOI_INCOMPLETE;
+}
+
+/**
+ * @brief Copies the state of a `struct hanoi_puzzle` into a `struct hanoi_bitboard`.
+ *
+ * @param bb Target `struct hanoi_bitboard`.
+ * @param pzl
+ * @return true - The state was copied.
+ * @return false - The puzzle has too many rods or disks for a bitboard.
+ */
+bool
+hanoi_bitboard_from_puzzle (struct hanoi_bitboard *bb, const struct hanoi_puzzle *pzl)
+{
+  if (hanoi_bitboard_init (bb, pzl->n_rods, pzl->n_disks) != HANOI_INIT_OK)
+    {
+      return false;
+    }
+
+  for (uint32_t i = 0; i < pzl->n_rods; ++i)
+    {
+      bb->rods[i] = 0;
+
+      for (uint32_t j = 0; j < pzl->heights[i]; ++j)
+        {
+          bb->rods[i] |= (uint64_t)1 << (pzl->state[i][j] - 1);
+        }
+    }
+
+  return true;
+}
+
+/**
+ * @brief Copies the state of a `struct hanoi_bitboard` into a `struct hanoi_puzzle` of the same
+ * size.
+ *
+ * @param bb
+ * @param pzl Target `struct hanoi_puzzle`.
+ */
+void
+hanoi_bitboard_to_puzzle (const struct hanoi_bitboard *bb, struct hanoi_puzzle *pzl)
+{
+  for (uint32_t i = 0; i < bb->n_rods; ++i)
+    {
+      uint32_t j = 0;
+
+      for (uint64_t rod = bb->rods[i]; rod != 0;)
+        {
+          const uint32_t d = 63 - __builtin_clzll (rod);
+          rod ^= (uint64_t)1 << d;
+          pzl->state[i][j++] = d + 1;
+        }
+
+      pzl->heights[i] = j;
+
+      for (; j < bb->n_disks; ++j)
+        {
+          pzl->state[i][j] = 0;
+        }
+    }
+
+  pzl->complete_rod = hanoi_bitboard_complete (bb);
+}
@@ -0,0 +1,45 @@
+
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hanoi.h"
+
+#define HANOI_BITBOARD_MAX_RODS 8
+#define HANOI_BITBOARD_MAX_DISKS 64
+
+/**
+ * Puzzle where every rod is a mask of the disks on it. Disk `d` (of size `d`) is bit `d - 1`, so the
+ * top disk of a rod is its lowest set bit.
+ */
+struct hanoi_bitboard
+{
+  uint64_t rods[HANOI_BITBOARD_MAX_RODS];
+  uint32_t n_rods;
+  uint32_t n_disks;
+};
+
+enum hanoi_init_response
+hanoi_bitboard_init (struct hanoi_bitboard *bb, const uint32_t n_rods, const uint32_t n_disks);
+
+bool
+hanoi_bitboard_move (struct hanoi_bitboard *bb, const uint32_t src_i, const uint32_t des_i);
+
+bool
+hanoi_bitboard_empty_rod (const struct hanoi_bitboard *bb, const uint32_t i);
+
+uint32_t
+hanoi_bitboard_top_disk (const struct hanoi_bitboard *bb, const uint32_t i);
+
+uint32_t
+hanoi_bitboard_complete (const struct hanoi_bitboard *bb);
+
+bool
+hanoi_bitboard_from_puzzle (struct hanoi_bitboard *bb, const struct hanoi_puzzle *pzl);
+
+void
+hanoi_bitboard_to_puzzle (const struct hanoi_bitboard *bb, struct hanoi_puzzle *pzl);
+
+#endif /* BITBOARD_H */
\ No newline at end of file
@@ -0,0 +1,577 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "explore.h"
+
+#define BLOCK_STATES 4096
+#define SMALL_LEVEL_STATES (4 * BLOCK_STATES)
+
+/**
+ * States of one level of the search. The first `max` states are kept in memory and the rest is
+ * appended to an unlinked temporary file.
+ */
+struct level
+{
+  pthread_mutex_t lock;
+  uint64_t *states;
+  size_t len;
+  size_t cap;
+  size_t max;
+  FILE *spill;
+  uint64_t n_spilled;
+  const char *spill_directory;
+  size_t read_i;
+};
+
+enum phase
+{
+  PHASE_MARK,
+  PHASE_EXPAND,
+  PHASE_EXIT,
+};
+
+struct explorer
+{
+  uint32_t n_rods;
+  uint32_t n_disks;
+  uint32_t shift;
+  uint64_t powers[64];
+  uint64_t *seen;
+  uint64_t *old;
+  uint64_t *paths;
+  struct level levels[2];
+  struct level *current;
+  struct level *next;
+  uint32_t distance;
+  enum phase phase;
+  /* Set by any worker that runs out of memory, so only ever accessed atomically. */
+  bool failed;
+  pthread_mutex_t gate;
+  pthread_barrier_t start;
+  pthread_barrier_t done;
+  hanoi_explore_callback callback;
+  void *data;
+};
+
+struct worker
+{
+  struct explorer *explorer;
+  pthread_t thread;
+  uint64_t in[BLOCK_STATES];
+  uint64_t out[BLOCK_STATES];
+};
+
+static void
+level_init (struct level *level, const size_t max, const char *spill_directory)
+{
+  pthread_mutex_init (&level->lock, NULL);
+  level->states = NULL;
+  level->len = 0;
+  level->cap = 0;
+  level->max = max == 0 ? SIZE_MAX : max;
+  level->spill = NULL;
+  level->n_spilled = 0;
+  level->spill_directory = spill_directory == NULL ? P_tmpdir : spill_directory;
+  level->read_i = 0;
+}
+
+static void
+level_free (struct level *level)
+{
+  pthread_mutex_destroy (&level->lock);
+  free (level->states);
+  if (level->spill != NULL)
+    {
+      fclose (level->spill);
+    }
+}
+
+static uint64_t
+level_size (const struct level *level)
+{
+  return level->len + level->n_spilled;
+}
+
+static FILE *
+open_spill (const char *directory)
+{
+  const char name[] = "/hanoi-explore-XXXXXX";
+  char *path = malloc (strlen (directory) + sizeof (name));
+
+  if (path == NULL)
+    {
+      return NULL;
+    }
+
+  strcpy (path, directory);
+  strcat (path, name);
+
+  const int fd = mkstemp (path);
+  if (fd == -1)
+    {
+      free (path);
+      return NULL;
+    }
+
+  unlink (path);
+  free (path);
+
+  FILE *file = fdopen (fd, "w+b");
+  if (file == NULL)
+    {
+      close (fd);
+    }
+
+  return file;
+}
+
+static bool
+level_push (struct level *level, const uint64_t *states, const size_t n)
+{
+  bool ok = true;
+
+  pthread_mutex_lock (&level->lock);
+
+  size_t room = level->max - level->len;
+  room = room < n ? room : n;
+
+  if (room > 0 && level->len + room > level->cap)
+    {
+      size_t cap = level->cap == 0 ? BLOCK_STATES : level->cap;
+      while (cap < level->len + room)
+        {
+          cap *= 2;
+        }
+      cap = cap < level->max ? cap : level->max;
+
+      uint64_t *states = realloc (level->states, sizeof (states[0]) * cap);
+      if (states == NULL)
+        {
+          /* Keep going with what fits, the rest goes to disk. */
+          room = level->cap - level->len;
+        }
+      else
+        {
+          level->states = states;
+          level->cap = cap;
+        }
+    }
+
+  memcpy (level->states + level->len, states, sizeof (states[0]) * room);
+  level->len += room;
+
+  if (room < n)
+    {
+      if (level->spill == NULL)
+        {
+          level->spill = open_spill (level->spill_directory);
+        }
+
+      ok = level->spill != NULL
+           && fwrite (states + room, sizeof (states[0]), n - room, level->spill) == n - room;
+      level->n_spilled += n - room;
+    }
+
+  pthread_mutex_unlock (&level->lock);
+
+  return ok;
+}
+
+static bool
+level_rewind (struct level *level)
+{
+  level->read_i = 0;
+  return level->spill == NULL || fseek (level->spill, 0, SEEK_SET) == 0;
+}
+
+static void
+level_clear (struct level *level)
+{
+  level->len = 0;
+  level->n_spilled = 0;
+  level->read_i = 0;
+  if (level->spill != NULL)
+    {
+      fclose (level->spill);
+      level->spill = NULL;
+    }
+}
+
+/**
+ * Claims the next block of states of a level. States in memory are handed out without locking.
+ */
+static size_t
+level_pop (struct level *level, uint64_t *buf, const uint64_t **states)
+{
+  const size_t i = __atomic_fetch_add (&level->read_i, BLOCK_STATES, __ATOMIC_RELAXED);
+
+  if (i < level->len)
+    {
+      *states = level->states + i;
+      return level->len - i < BLOCK_STATES ? level->len - i : BLOCK_STATES;
+    }
+
+  if (level->spill == NULL)
+    {
+      return 0;
+    }
+
+  pthread_mutex_lock (&level->lock);
+  const size_t n = fread (buf, sizeof (buf[0]), BLOCK_STATES, level->spill);
+  pthread_mutex_unlock (&level->lock);
+
+  *states = buf;
+  return n;
+}
+
+static bool
+test_bit (const uint64_t *bits, const uint64_t i)
+{
+  return (__atomic_load_n (&bits[i / 64], __ATOMIC_RELAXED) >> (i % 64)) & 1;
+}
+
+static bool
+test_and_set_bit (uint64_t *bits, const uint64_t i)
+{
+  const uint64_t mask = (uint64_t)1 << (i % 64);
+  return __atomic_fetch_or (&bits[i / 64], mask, __ATOMIC_RELAXED) & mask;
+}
+
+static void
+expand (struct explorer *explorer, struct worker *worker, const uint64_t state, size_t *n_out)
+{
+  const uint32_t n_rods = explorer->n_rods;
+  uint32_t tops[n_rods];
+
+  for (uint32_t i = 0; i < n_rods; ++i)
+    {
+      tops[i] = 0;
+    }
+
+  uint64_t r = state;
+  if (explorer->shift != 0)
+    {
+      for (uint32_t d = 1; d <= explorer->n_disks; ++d, r >>= explorer->shift)
+        {
+          const uint32_t i = r & (n_rods - 1);
+          tops[i] = tops[i] == 0 ? d : tops[i];
+        }
+    }
+  else
+    {
+      for (uint32_t d = 1; d <= explorer->n_disks; ++d, r /= n_rods)
+        {
+          const uint32_t i = r % n_rods;
+          tops[i] = tops[i] == 0 ? d : tops[i];
+        }
+    }
+
+  for (uint32_t src_i = 0; src_i < n_rods; ++src_i)
+    {
+      const uint32_t src = tops[src_i];
+
+      if (src == 0)
+        {
+          continue;
+        }
+
+      for (uint32_t des_i = 0; des_i < n_rods; ++des_i)
+        {
+          if (des_i == src_i || (tops[des_i] != 0 && tops[des_i] < src))
+            {
+              continue;
+            }
+
+          const uint64_t next = state + (des_i - (uint64_t)src_i) * explorer->powers[src - 1];
+
+          if (explorer->paths != NULL && !test_bit (explorer->old, next))
+            {
+              __atomic_fetch_add (&explorer->paths[next], explorer->paths[state], __ATOMIC_RELAXED);
+            }
+
+          if (!test_bit (explorer->seen, next) && !test_and_set_bit (explorer->seen, next))
+            {
+              worker->out[(*n_out)++] = next;
+
+              if (*n_out == BLOCK_STATES)
+                {
+                  if (!level_push (explorer->next, worker->out, *n_out))
+                    {
+                      __atomic_store_n (&explorer->failed, true, __ATOMIC_RELAXED);
+                    }
+                  *n_out = 0;
+                }
+            }
+        }
+    }
+}
+
+static void
+run_phase (struct explorer *explorer, struct worker *worker)
+{
+  const uint64_t *states;
+  size_t n;
+  size_t n_out = 0;
+
+  while ((n = level_pop (explorer->current, worker->in, &states)) > 0)
+    {
+      if (explorer->phase == PHASE_MARK)
+        {
+          for (size_t i = 0; i < n; ++i)
+            {
+              test_and_set_bit (explorer->old, states[i]);
+            }
+          continue;
+        }
+
+      if (explorer->callback != NULL)
+        {
+          explorer->callback (explorer->distance, states, n, explorer->data);
+        }
+
+      for (size_t i = 0; i < n; ++i)
+        {
+          expand (explorer, worker, states[i], &n_out);
+        }
+    }
+
+  if (n_out > 0 && !level_push (explorer->next, worker->out, n_out))
+    {
+      __atomic_store_n (&explorer->failed, true, __ATOMIC_RELAXED);
+    }
+}
+
+static void *
+run_worker (void *arg)
+{
+  struct worker *worker = arg;
+  struct explorer *explorer = worker->explorer;
+
+  /* The barriers are sized once every thread is started. */
+  pthread_mutex_lock (&explorer->gate);
+  pthread_mutex_unlock (&explorer->gate);
+
+  while (true)
+    {
+      pthread_barrier_wait (&explorer->start);
+      if (explorer->phase == PHASE_EXIT)
+        {
+          return NULL;
+        }
+      run_phase (explorer, worker);
+      pthread_barrier_wait (&explorer->done);
+    }
+}
+
+static void
+run (struct explorer *explorer, struct worker *workers, const uint32_t n_threads,
+     const enum phase phase)
+{
+  explorer->phase = phase;
+
+  if (!level_rewind (explorer->current))
+    {
+      __atomic_store_n (&explorer->failed, true, __ATOMIC_RELAXED);
+      return;
+    }
+
+  if (n_threads == 1 || level_size (explorer->current) < SMALL_LEVEL_STATES)
+    {
+      run_phase (explorer, &workers[0]);
+      return;
+    }
+
+  pthread_barrier_wait (&explorer->start);
+  run_phase (explorer, &workers[0]);
+  pthread_barrier_wait (&explorer->done);
+}
+
+/**
+ * @brief Breadth first search over every state reachable from `source` using the rules of
+ * `hanoi_move`. States are ranks of `hanoi_rank`. The visited states are kept as a bitmap of
+ * n_rods^n_disks bits, two bitmaps if `options->paths` is set, and every level is expanded by all
+ * worker threads.
+ *
+ * @param n_rods Amount of rods in the puzzle.
+ * @param n_disks Amount of disks in the puzzle.
+ * @param source Rank of the state to start from. 0 is the layout of `hanoi_init`.
+ * @param options May be NULL.
+ * @param result Receives the result. Must be freed using `hanoi_explore_result_free` if the search
+ * is successful.
+ * @return true - The search completed.
+ * @return false - System failure during the search or n_rods^n_disks does not fit in 64 bits.
+ * Check `errno`.
+ */
+bool
+hanoi_explore (const uint32_t n_rods, const uint32_t n_disks, const uint64_t source,
+               const struct hanoi_explore_options *options, struct hanoi_explore_result *result)
+{
+  const struct hanoi_explore_options defaults = { 0 };
+  struct explorer explorer;
+  uint64_t n_states = 1;
+
+  if (options == NULL)
+    {
+      options = &defaults;
+    }
+
+  for (uint32_t d = 0; d < n_disks; ++d)
+    {
+      if (d < 64)
+        {
+          explorer.powers[d] = n_states;
+        }
+      if (n_rods == 0 || __builtin_mul_overflow (n_states, n_rods, &n_states))
+        {
+          errno = EOVERFLOW;
+          return false;
+        }
+    }
+
+  if (source >= n_states)
+    {
+      errno = EINVAL;
+      return false;
+    }
+
+  uint32_t n_threads = options->n_threads;
+  if (n_threads == 0)
+    {
+      const long n = sysconf (_SC_NPROCESSORS_ONLN);
+      n_threads = n > 0 ? n : 1;
+    }
+
+  explorer.n_rods = n_rods;
+  explorer.n_disks = n_disks;
+  explorer.shift = (n_rods & (n_rods - 1)) == 0 ? __builtin_ctz (n_rods) : 0;
+  explorer.paths = options->paths;
+  explorer.callback = options->callback;
+  explorer.data = options->data;
+  explorer.failed = false;
+  explorer.distance = 0;
+  explorer.current = &explorer.levels[0];
+  explorer.next = &explorer.levels[1];
+
+  explorer.seen = calloc ((n_states + 63) / 64, sizeof (uint64_t));
+  explorer.old = explorer.paths == NULL ? NULL : calloc ((n_states + 63) / 64, sizeof (uint64_t));
+  struct worker *workers = malloc (sizeof (workers[0]) * n_threads);
+  size_t cap = 64;
+  result->level_sizes = malloc (sizeof (result->level_sizes[0]) * cap);
+
+  if (explorer.seen == NULL || (explorer.paths != NULL && explorer.old == NULL) || workers == NULL
+      || result->level_sizes == NULL)
+    {
+      free (explorer.seen);
+      free (explorer.old);
+      free (workers);
+      free (result->level_sizes);
+      return false;
+    }
+
+  level_init (&explorer.levels[0], options->max_level_states, options->spill_directory);
+  level_init (&explorer.levels[1], options->max_level_states, options->spill_directory);
+  pthread_mutex_init (&explorer.gate, NULL);
+  pthread_mutex_lock (&explorer.gate);
+
+  uint32_t n_started = 1;
+  workers[0].explorer = &explorer;
+
+  for (; n_started < n_threads; ++n_started)
+    {
+      workers[n_started].explorer = &explorer;
+      if (pthread_create (&workers[n_started].thread, NULL, run_worker, &workers[n_started]) != 0)
+        {
+          break;
+        }
+    }
+
+  pthread_barrier_init (&explorer.start, NULL, n_started);
+  pthread_barrier_init (&explorer.done, NULL, n_started);
+  pthread_mutex_unlock (&explorer.gate);
+
+  test_and_set_bit (explorer.seen, source);
+  if (explorer.paths != NULL)
+    {
+      explorer.paths[source] = 1;
+    }
+
+  result->n_states = 0;
+
+  if (!__atomic_load_n (&explorer.failed, __ATOMIC_RELAXED)
+      && !level_push (explorer.current, &source, 1))
+    {
+      __atomic_store_n (&explorer.failed, true, __ATOMIC_RELAXED);
+    }
+
+  while (!__atomic_load_n (&explorer.failed, __ATOMIC_RELAXED) && level_size (explorer.current) > 0)
+    {
+      if (explorer.distance == cap)
+        {
+          cap *= 2;
+          uint64_t *level_sizes = realloc (result->level_sizes, sizeof (level_sizes[0]) * cap);
+          if (level_sizes == NULL)
+            {
+              __atomic_store_n (&explorer.failed, true, __ATOMIC_RELAXED);
+              break;
+            }
+          result->level_sizes = level_sizes;
+        }
+
+      result->level_sizes[explorer.distance] = level_size (explorer.current);
+      result->n_states += level_size (explorer.current);
+
+      if (explorer.paths != NULL)
+        {
+          run (&explorer, workers, n_started, PHASE_MARK);
+        }
+
+      run (&explorer, workers, n_started, PHASE_EXPAND);
+
+      struct level *done = explorer.current;
+      explorer.current = explorer.next;
+      explorer.next = done;
+      level_clear (explorer.next);
+      explorer.distance += 1;
+    }
+
+  explorer.phase = PHASE_EXIT;
+  if (n_started > 1)
+    {
+      pthread_barrier_wait (&explorer.start);
+    }
+
+  for (uint32_t i = 1; i < n_started; ++i)
+    {
+      pthread_join (workers[i].thread, NULL);
+    }
+
+  pthread_barrier_destroy (&explorer.start);
+  pthread_barrier_destroy (&explorer.done);
+  pthread_mutex_destroy (&explorer.gate);
+  level_free (&explorer.levels[0]);
+  level_free (&explorer.levels[1]);
+  free (explorer.seen);
+  free (explorer.old);
+  free (workers);
+
+  if (__atomic_load_n (&explorer.failed, __ATOMIC_RELAXED))
+    {
+      free (result->level_sizes);
+      return false;
+    }
+
+  result->max_distance = explorer.distance - 1;
+  return true;
+}
+
+void
+hanoi_explore_result_free (struct hanoi_explore_result *result)
+{
+  free (result->level_sizes);
+}
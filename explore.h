@@ -0,0 +1,47 @@
+
+#ifndef EXPLORE_H
+#define EXPLORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Called with the states, as ranks of `hanoi_rank`, of one level of the search in blocks. May be
+ * called from several threads at the same time.
+ */
+typedef void (*hanoi_explore_callback) (const uint32_t distance, const uint64_t *states,
+                                        const size_t n_states, void *data);
+
+struct hanoi_explore_options
+{
+  /* Amount of worker threads. 0 uses one per online core. */
+  uint32_t n_threads;
+  /* Amount of states of a level kept in memory before the rest is written to disk. 0 keeps all. */
+  size_t max_level_states;
+  /* Directory for levels written to disk. NULL uses `P_tmpdir`. */
+  const char *spill_directory;
+  /* If not NULL, receives the amount of shortest paths from the source to every state. Must hold
+     n_rods^n_disks zeroed entries. */
+  uint64_t *paths;
+  hanoi_explore_callback callback;
+  void *data;
+};
+
+struct hanoi_explore_result
+{
+  uint64_t n_states;
+  /* Distance from the source to the states furthest away from it. */
+  uint32_t max_distance;
+  /* Amount of states at every distance from 0 up to and including `max_distance`. */
+  uint64_t *level_sizes;
+};
+
+bool
+hanoi_explore (const uint32_t n_rods, const uint32_t n_disks, const uint64_t source,
+               const struct hanoi_explore_options *options, struct hanoi_explore_result *result);
+
+void
+hanoi_explore_result_free (struct hanoi_explore_result *result);
+
+#endif /* EXPLORE_H */
\ No newline at end of file
@@ -0,0 +1,395 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "archive.h"
+#include "export.h"
+#include "hanoi.h"
+#include "record.h"
+#include "solve.h"
+
+#define error(...)                                                                                 \
+  {                                                                                                \
+    fprintf (stderr, "ERROR %s:%d - ", __FILE__, __LINE__);                                        \
+    fprintf (stderr, __VA_ARGS__);                                                                 \
+  }
+
+struct game
+{
+  /* Index of the game in the archive. */
+  size_t game;
+  uint64_t n_moves;
+};
+
+/**
+ * Games are collected and checked first, so the size of every column is known before anything is
+ * written and the export can be filled in place.
+ */
+struct exporter
+{
+  struct hanoi_archive archive;
+  struct game *games;
+  size_t n_games;
+  size_t games_cap;
+  uint64_t n_moves;
+  uint64_t n_skipped;
+  struct hanoi_puzzle pzl;
+  bool has_pzl;
+};
+
+static const size_t column_element_size[HANOI_EXPORT_N_COLUMNS] = {
+  [HANOI_EXPORT_USERNAME] = HANOI_RECORD_MAX_USERNAME_LEN,
+  [HANOI_EXPORT_N_RODS] = sizeof (uint32_t),
+  [HANOI_EXPORT_N_DISKS] = sizeof (uint32_t),
+  [HANOI_EXPORT_DATE] = sizeof (uint64_t),
+  [HANOI_EXPORT_DURATION] = sizeof (uint64_t),
+  [HANOI_EXPORT_N_MOVES] = sizeof (uint64_t),
+  [HANOI_EXPORT_DEVIATIONS] = sizeof (uint64_t),
+  [HANOI_EXPORT_MOVE_START] = sizeof (uint64_t),
+  [HANOI_EXPORT_MOVE_DURATIONS] = sizeof (uint64_t),
+};
+
+/**
+ * @brief Makes `exporter->pzl` a puzzle of the given size, reusing it if it already is one.
+ */
+static bool
+load_puzzle (struct exporter *exporter, const uint32_t n_rods, const uint32_t n_disks)
+{
+  if (exporter->has_pzl && exporter->pzl.n_rods == n_rods && exporter->pzl.n_disks == n_disks)
+    {
+      return true;
+    }
+
+  if (exporter->has_pzl)
+    {
+      hanoi_free (&exporter->pzl);
+    }
+
+  exporter->has_pzl = hanoi_init (&exporter->pzl, n_rods, n_disks) == HANOI_INIT_OK;
+
+  return exporter->has_pzl;
+}
+
+/**
+ * @brief Checks a game the way `hanoi-verify` does. Its checksum must match, every move must be
+ * legal when replayed from its snapshot, its keyframes must match the replay and it must end
+ * complete.
+ */
+static bool
+valid_game (struct exporter *exporter, const struct hanoi_record *record)
+{
+  uint64_t n_played;
+
+  return hanoi_record_checksum_valid (record)
+         && load_puzzle (exporter, hanoi_record_n_rods (record), hanoi_record_n_disks (record))
+         && hanoi_record_replay (record, &exporter->pzl, &n_played) == HANOI_REPLAY_OK
+         && hanoi_record_keyframes_valid (record)
+         && hanoi_complete (&exporter->pzl) != HANOI_INCOMPLETE;
+}
+
+/**
+ * @brief Adds a game to the export if it is a valid completed game, see `valid_game`.
+ */
+static bool
+push_game (struct exporter *exporter, const struct hanoi_record *record, const size_t game)
+{
+  if (!valid_game (exporter, record))
+    {
+      ++exporter->n_skipped;
+      return true;
+    }
+
+  if (exporter->n_games == exporter->games_cap)
+    {
+      const size_t cap = exporter->games_cap > 0 ? 2 * exporter->games_cap : 1024;
+      struct game *games = realloc (exporter->games, cap * sizeof (games[0]));
+
+      if (games == NULL)
+        {
+          return false;
+        }
+      exporter->games = games;
+      exporter->games_cap = cap;
+    }
+
+  const uint64_t n_moves = hanoi_record_n_moves (record);
+
+  exporter->games[exporter->n_games++] = (struct game){ .game = game, .n_moves = n_moves };
+  exporter->n_moves += n_moves;
+
+  return true;
+}
+
+/**
+ * @brief Reads every game of the archive once, keeping the valid completed ones.
+ */
+static bool
+collect_games (struct exporter *exporter)
+{
+  bool ok = true;
+
+  for (size_t i = 0; ok && i < exporter->archive.n_games; ++i)
+    {
+      struct hanoi_archive_record record;
+
+      if (hanoi_archive_record (&exporter->archive, i, &record))
+        {
+          ok = push_game (exporter, &record.record, i);
+          hanoi_archive_record_close (&record);
+        }
+      else
+        {
+          ++exporter->n_skipped;
+        }
+    }
+
+  return ok;
+}
+
+/**
+ * @brief Counts the moves of a game that were not optimal. A move is optimal if it takes the puzzle
+ * one move closer to being complete on any rod but the one it was complete on at the start, as
+ * told by `hanoi_solve_hint`.
+ *
+ * @return The amount of deviations, or `HANOI_EXPORT_UNKNOWN` if the puzzle has no hints.
+ */
+static uint64_t
+count_deviations (struct exporter *exporter, const struct hanoi_record *record)
+{
+  const uint32_t n_rods = hanoi_record_n_rods (record);
+  const uint32_t n_disks = hanoi_record_n_disks (record);
+
+  if (n_rods != 3 || n_disks > 64)
+    {
+      return HANOI_EXPORT_UNKNOWN;
+    }
+
+  if (!load_puzzle (exporter, n_rods, n_disks))
+    {
+      return HANOI_EXPORT_UNKNOWN;
+    }
+
+  struct hanoi_puzzle *pzl = &exporter->pzl;
+
+  if (!hanoi_record_load_snapshot (record, pzl))
+    {
+      return HANOI_EXPORT_UNKNOWN;
+    }
+
+  const uint32_t start_i = hanoi_complete (pzl);
+  struct hanoi_hint hint;
+  hanoi_solve_hint (pzl, start_i, &hint);
+
+  struct hanoi_record_iterator it;
+  struct hanoi_record_move move;
+  uint64_t deviations = 0;
+
+  hanoi_record_iterator_init (&it, record);
+  while (hanoi_record_iterator_next (&it, &move))
+    {
+      const uint64_t n_left = hint.n_moves;
+
+      if (move.src_i >= pzl->n_rods || move.des_i >= pzl->n_rods
+          || !hanoi_move (pzl, move.src_i, move.des_i))
+        {
+          return HANOI_EXPORT_UNKNOWN;
+        }
+
+      hanoi_solve_hint (pzl, start_i, &hint);
+      deviations += hint.n_moves + 1 != n_left;
+    }
+
+  return deviations;
+}
+
+static void
+export_game (struct exporter *exporter, const struct game *game, const struct hanoi_record *record,
+             const size_t i, uint8_t *map, const struct hanoi_export_header *header,
+             uint64_t *move_i)
+{
+#define COLUMN(type, column) ((type *)(map + header->columns[column].offset))
+
+  memcpy (COLUMN (char, HANOI_EXPORT_USERNAME) + i * HANOI_RECORD_MAX_USERNAME_LEN,
+          hanoi_record_username (record), HANOI_RECORD_MAX_USERNAME_LEN);
+  COLUMN (uint32_t, HANOI_EXPORT_N_RODS)[i] = hanoi_record_n_rods (record);
+  COLUMN (uint32_t, HANOI_EXPORT_N_DISKS)[i] = hanoi_record_n_disks (record);
+  COLUMN (uint64_t, HANOI_EXPORT_DATE)[i] = hanoi_record_date (record);
+  COLUMN (uint64_t, HANOI_EXPORT_N_MOVES)[i] = game->n_moves;
+  COLUMN (uint64_t, HANOI_EXPORT_DEVIATIONS)[i] = count_deviations (exporter, record);
+  COLUMN (uint64_t, HANOI_EXPORT_MOVE_START)[i] = *move_i;
+
+  uint64_t *durations = COLUMN (uint64_t, HANOI_EXPORT_MOVE_DURATIONS) + *move_i;
+  struct hanoi_record_iterator it;
+  struct hanoi_record_move move;
+  uint64_t duration = 0;
+  uint64_t k = 0;
+
+  hanoi_record_iterator_init (&it, record);
+  for (; k < game->n_moves && hanoi_record_iterator_next (&it, &move); ++k)
+    {
+      durations[k] = move.duration - duration;
+      duration = move.duration;
+    }
+
+  /* Keeps the columns in step if the log ends early, which a valid checksum rules out. */
+  for (; k < game->n_moves; ++k)
+    {
+      durations[k] = 0;
+    }
+
+  COLUMN (uint64_t, HANOI_EXPORT_DURATION)[i] = duration;
+  *move_i += game->n_moves;
+
+#undef COLUMN
+}
+
+/**
+ * @brief Writes every collected game to `path`. The file is sized and mapped first and every
+ * column filled in place.
+ */
+static bool
+write_export (struct exporter *exporter, const char *path)
+{
+  struct hanoi_export_header header = {
+    .magic = HANOI_EXPORT_MAGIC,
+    .version = HANOI_EXPORT_VERSION,
+    .n_columns = HANOI_EXPORT_N_COLUMNS,
+    .n_games = exporter->n_games,
+    .n_moves = exporter->n_moves,
+  };
+
+  uint64_t offset = sizeof (header);
+
+  for (int c = 0; c < HANOI_EXPORT_N_COLUMNS; ++c)
+    {
+      const uint64_t n = c == HANOI_EXPORT_MOVE_START       ? exporter->n_games + 1
+                         : c == HANOI_EXPORT_MOVE_DURATIONS ? exporter->n_moves
+                                                            : exporter->n_games;
+
+      offset = (offset + HANOI_EXPORT_ALIGNMENT - 1) / HANOI_EXPORT_ALIGNMENT
+               * HANOI_EXPORT_ALIGNMENT;
+      header.columns[c].offset = offset;
+      header.columns[c].size = n * column_element_size[c];
+      offset += header.columns[c].size;
+    }
+
+  const int fd = open (path, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd == -1)
+    {
+      return false;
+    }
+
+  uint8_t *map = MAP_FAILED;
+
+  if (ftruncate (fd, offset) == 0)
+    {
+      map = mmap (NULL, offset, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+  if (map == MAP_FAILED)
+    {
+      const int error = errno;
+      close (fd);
+      errno = error;
+      return false;
+    }
+
+  memcpy (map, &header, sizeof (header));
+
+  uint64_t move_i = 0;
+
+  for (size_t i = 0; i < exporter->n_games; ++i)
+    {
+      const struct game *game = &exporter->games[i];
+      struct hanoi_archive_record record;
+
+      /* The games were read once already, so they only fail here if they changed since. */
+      if (!hanoi_archive_record (&exporter->archive, game->game, &record))
+        {
+          munmap (map, offset);
+          close (fd);
+          errno = EIO;
+          return false;
+        }
+
+      export_game (exporter, game, &record.record, i, map, &header, &move_i);
+      hanoi_archive_record_close (&record);
+    }
+
+  ((uint64_t *)(map + header.columns[HANOI_EXPORT_MOVE_START].offset))[exporter->n_games] = move_i;
+
+  munmap (map, offset);
+
+  return close (fd) == 0;
+}
+
+static void
+print_help (const char *program)
+{
+  printf ("usage: %s\n", program);
+  printf ("    [ --output=<path> ]\n");
+  printf ("    [ --help ]\n");
+  printf ("    <records directory | .hanoi-segment | .hanoi-puzzle>...\n");
+}
+
+int
+main (int argc, char **argv)
+{
+  struct exporter exporter = { 0 };
+  const char *output = "records.hanoi-export";
+  bool ok = argc > 1;
+
+  for (int i = 1; ok && i < argc; ++i)
+    {
+      if (strncmp (argv[i], "--output=", strlen ("--output=")) == 0)
+        {
+          output = argv[i] + strlen ("--output=");
+        }
+      else if (strcmp (argv[i], "--help") == 0)
+        {
+          print_help (argv[0]);
+          return 0;
+        }
+      else if (!hanoi_archive_add (&exporter.archive, argv[i]))
+        {
+          error ("%s: %s\n", argv[i], strerror (errno));
+          ok = false;
+        }
+    }
+
+  if (argc == 1)
+    {
+      print_help (argv[0]);
+    }
+  else if (ok && !collect_games (&exporter))
+    {
+      error ("%s\n", strerror (errno));
+      ok = false;
+    }
+  else if (ok && !write_export (&exporter, output))
+    {
+      error ("%s: %s\n", output, strerror (errno));
+      ok = false;
+    }
+  else if (ok)
+    {
+      printf ("%zu games, %lu moves exported to %s, %lu records skipped\n", exporter.n_games,
+              (unsigned long)exporter.n_moves, output, (unsigned long)exporter.n_skipped);
+    }
+
+  hanoi_archive_free (&exporter.archive);
+  free (exporter.games);
+  if (exporter.has_pzl)
+    {
+      hanoi_free (&exporter.pzl);
+    }
+
+  return ok ? 0 : 1;
+}
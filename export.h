@@ -0,0 +1,59 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdint.h>
+
+/* "HNOIXPRT" */
+#define HANOI_EXPORT_MAGIC 0x54525058494f4e48
+#define HANOI_EXPORT_VERSION 1
+/* Every column starts on a cache line so it can be scanned with aligned vector loads. */
+#define HANOI_EXPORT_ALIGNMENT 64
+/* Deviations of a game that could not be measured, see `HANOI_EXPORT_DEVIATIONS`. */
+#define HANOI_EXPORT_UNKNOWN UINT64_MAX
+
+/**
+ * Columns of an export written by `hanoi-export`, each one contiguous array with an element per
+ * game unless noted otherwise.
+ */
+enum hanoi_export_column
+{
+  /* char[HANOI_RECORD_MAX_USERNAME_LEN] */
+  HANOI_EXPORT_USERNAME,
+  /* uint32_t */
+  HANOI_EXPORT_N_RODS,
+  /* uint32_t */
+  HANOI_EXPORT_N_DISKS,
+  /* uint64_t, seconds since the epoch. */
+  HANOI_EXPORT_DATE,
+  /* uint64_t, the duration of the last move. */
+  HANOI_EXPORT_DURATION,
+  /* uint64_t */
+  HANOI_EXPORT_N_MOVES,
+  /* uint64_t, moves that did not bring the puzzle one move closer to being complete on a rod other
+     than the one it started on. Only measured for 3 rods, otherwise `HANOI_EXPORT_UNKNOWN`. */
+  HANOI_EXPORT_DEVIATIONS,
+  /* uint64_t, n_games + 1 elements. The moves of game i are elements `[start[i], start[i + 1])`
+     of `HANOI_EXPORT_MOVE_DURATIONS`. */
+  HANOI_EXPORT_MOVE_START,
+  /* uint64_t, n_moves elements. Time since the previous move of the game. */
+  HANOI_EXPORT_MOVE_DURATIONS,
+  HANOI_EXPORT_N_COLUMNS,
+};
+
+struct hanoi_export_column_range
+{
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct hanoi_export_header
+{
+  uint64_t magic;
+  uint32_t version;
+  uint32_t n_columns;
+  uint64_t n_games;
+  uint64_t n_moves;
+  struct hanoi_export_column_range columns[HANOI_EXPORT_N_COLUMNS];
+};
+
+#endif /* EXPORT_H */
\ No newline at end of file
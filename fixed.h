@@ -0,0 +1,125 @@
+
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hanoi.h"
+
+/**
+ * Defines `struct hanoi_fixed_RxD`, a puzzle with `R` rods and `D` disks known at compile time,
+ * and static inline functions `hanoi_fixed_RxD_*` mirroring the `hanoi_*` ones. The state is kept
+ * inline in the struct, one byte per cell, laid out like `struct hanoi_puzzle`, so nothing is
+ * allocated and the loops unroll. `_from_puzzle` and `_to_puzzle` convert to and from a generic
+ * puzzle of the same size.
+ *
+ * @param R Amount of rods.
+ * @param D Amount of disks. From 1 to 255.
+ */
+#define HANOI_DEFINE_FIXED(R, D)                                                                  \
+  _Static_assert ((R) > 0 && (D) > 0 && (D) <= UINT8_MAX, "unsupported fixed puzzle size");       \
+                                                                                                  \
+  struct hanoi_fixed_##R##x##D                                                                    \
+  {                                                                                               \
+    uint8_t state[R][D];                                                                          \
+    uint8_t heights[R];                                                                           \
+    uint32_t complete_rod;                                                                        \
+  };                                                                                              \
+                                                                                                  \
+  static inline void hanoi_fixed_##R##x##D##_init (struct hanoi_fixed_##R##x##D *pzl)             \
+  {                                                                                               \
+    for (uint32_t i = 0; i < (R); ++i)                                                            \
+      {                                                                                           \
+        for (uint32_t j = 0; j < (D); ++j)                                                        \
+          {                                                                                       \
+            pzl->state[i][j] = i == 0 ? (D) - j : 0;                                              \
+          }                                                                                       \
+        pzl->heights[i] = i == 0 ? (D) : 0;                                                       \
+      }                                                                                           \
+    pzl->complete_rod = 0;                                                                        \
+  }                                                                                               \
+                                                                                                  \
+  static inline bool hanoi_fixed_##R##x##D##_move (struct hanoi_fixed_##R##x##D *pzl,             \
+                                                   const uint32_t src_i, const uint32_t des_i)    \
+  {                                                                                               \
+    const uint32_t src_j = pzl->heights[src_i];                                                   \
+    if (src_j == 0)                                                                               \
+      {                                                                                           \
+        return false;                                                                             \
+      }                                                                                           \
+                                                                                                  \
+    const uint8_t src = pzl->state[src_i][src_j - 1];                                             \
+    const uint32_t des_j = pzl->heights[des_i];                                                   \
+    if (des_j == 0 || src < pzl->state[des_i][des_j - 1])                                         \
+      {                                                                                           \
+        pzl->state[src_i][src_j - 1] = 0;                                                         \
+        pzl->state[des_i][des_j] = src;                                                           \
+        pzl->heights[src_i] = src_j - 1;                                                          \
+        pzl->heights[des_i] = des_j + 1;                                                          \
+        pzl->complete_rod = des_j + 1 == (D) ? des_i : HANOI_INCOMPLETE;                          \
+        return true;                                                                              \
+      }                                                                                           \
+                                                                                                  \
+    return false;                                                                                 \
+  }                                                                                               \
+                                                                                                  \
+  static inline bool hanoi_fixed_##R##x##D##_empty_rod (const struct hanoi_fixed_##R##x##D *pzl, \
+                                                        const uint32_t i)                         \
+  {                                                                                               \
+    return pzl->heights[i] == 0;                                                                  \
+  }                                                                                               \
+                                                                                                  \
+  static inline uint32_t hanoi_fixed_##R##x##D##_top_disk (                                       \
+      const struct hanoi_fixed_##R##x##D *pzl, const uint32_t i)                                  \
+  {                                                                                               \
+    return pzl->heights[i] == 0 ? 0 : pzl->state[i][pzl->heights[i] - 1];                         \
+  }                                                                                               \
+                                                                                                  \
+  static inline uint32_t hanoi_fixed_##R##x##D##_complete (                                       \
+      const struct hanoi_fixed_##R##x##D *pzl)                                                    \
+  {                                                                                               \
+    return pzl->complete_rod;                                                                     \
+  }                                                                                               \
+                                                                                                  \
+  static inline bool hanoi_fixed_##R##x##D##_from_puzzle (struct hanoi_fixed_##R##x##D *fx,       \
+                                                          const struct hanoi_puzzle *pzl)         \
+  {                                                                                               \
+    if (pzl->n_rods != (R) || pzl->n_disks != (D))                                                \
+      {                                                                                           \
+        return false;                                                                             \
+      }                                                                                           \
+                                                                                                  \
+    for (uint32_t i = 0; i < (R); ++i)                                                            \
+      {                                                                                           \
+        for (uint32_t j = 0; j < (D); ++j)                                                        \
+          {                                                                                       \
+            fx->state[i][j] = pzl->state[i][j];                                                   \
+          }                                                                                       \
+        fx->heights[i] = pzl->heights[i];                                                         \
+      }                                                                                           \
+    fx->complete_rod = pzl->complete_rod;                                                         \
+                                                                                                  \
+    return true;                                                                                  \
+  }                                                                                               \
+                                                                                                  \
+  static inline void hanoi_fixed_##R##x##D##_to_puzzle (const struct hanoi_fixed_##R##x##D *fx,   \
+                                                        struct hanoi_puzzle *pzl)                 \
+  {                                                                                               \
+    for (uint32_t i = 0; i < (R); ++i)                                                            \
+      {                                                                                           \
+        for (uint32_t j = 0; j < (D); ++j)                                                        \
+          {                                                                                       \
+            pzl->state[i][j] = fx->state[i][j];                                                   \
+          }                                                                                       \
+        pzl->heights[i] = fx->heights[i];                                                         \
+      }                                                                                           \
+    pzl->complete_rod = fx->complete_rod;                                                         \
+  }
+
+/* The sizes used most, 3x4 being the default in main.c. */
+HANOI_DEFINE_FIXED (3, 4)
+HANOI_DEFINE_FIXED (3, 8)
+HANOI_DEFINE_FIXED (4, 10)
+
+#endif /* FIXED_H */
\ No newline at end of file
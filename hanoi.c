@@ -1,77 +1,125 @@
+#include <errno.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "hanoi.h"
+#include "stats.h"
 
 /**
- * @brief Initializes a `struct hanoi_puzzle`. A succsessfull init must be freed using `hanoi_free`.
+ * @brief Amount of memory needed by `hanoi_init_in` for a puzzle of a given size. Everything
+ * `struct hanoi_puzzle` points to is kept in it: the row pointers, the heights and the cells.
+ *
+ * @param n_rods Amount of rods in the puzzle.
+ * @param n_disks Amount of disks in the puzzle.
+ * @return size_t Size in bytes, or `SIZE_MAX` if it does not fit in a `size_t`.
+ */
+size_t
+hanoi_storage_size (const uint32_t n_rods, const uint32_t n_disks)
+{
+  size_t cells;
+  size_t size;
+
+  if (__builtin_mul_overflow ((size_t)n_rods, n_disks, &cells)
+      || __builtin_add_overflow (cells, n_rods, &cells)
+      || __builtin_mul_overflow (cells, sizeof (uint32_t), &size)
+      || __builtin_add_overflow (size, sizeof (uint32_t *) * n_rods, &size))
+    {
+      return SIZE_MAX;
+    }
+
+  return size;
+}
+
+/**
+ * @brief Initializes a `struct hanoi_puzzle` inside caller provided memory. Nothing is allocated,
+ * so the puzzle must not be passed to `hanoi_free`; it lives as long as `storage`.
  *
  * @param pzl Target `struct hanoi_puzzle`.
+ * @param storage At least `hanoi_storage_size (n_rods, n_disks)` bytes, aligned for a pointer.
  * @param n_rods Amount of rods in the puzzle.
  * @param n_disks Amount of disks in the puzzle.
  * @return HANOI_INIT_OK - Init successful.
  * @return HANOI_INIT_INVALID_N_RODS_VALUE - The value of `n_rods` was set to `HANOI_INCOMPLATE`.
- * @return HANOI_INIT_SYSTEM_ERROR - System failure during init. Check `errno`.
  */
 enum hanoi_init_response
-hanoi_init (struct hanoi_puzzle *pzl, const uint32_t n_rods, const uint32_t n_disks)
+hanoi_init_in (struct hanoi_puzzle *pzl, void *storage, const uint32_t n_rods,
+               const uint32_t n_disks)
 {
   if (n_rods == HANOI_INCOMPLETE)
     {
       return HANOI_INIT_INVALID_N_RODS_VALUE;
     }
 
-  uint32_t *st = calloc (n_rods * n_disks + 1, sizeof (uint32_t));
-  if (st == NULL)
-    {
-      return HANOI_INIT_SYSTEM_ERROR;
-    }
+  pzl->state = storage;
+  pzl->heights = (uint32_t *)(pzl->state + n_rods);
 
-  pzl->state = malloc (sizeof (pzl->state) * n_rods);
-  if (pzl->state == NULL)
-    {
-      free (st);
-      return HANOI_INIT_SYSTEM_ERROR;
-    }
+  uint32_t *st = pzl->heights + n_rods;
+
+  memset (pzl->heights, 0, sizeof (uint32_t) * ((size_t)n_rods + (size_t)n_rods * n_disks));
 
   for (uint32_t i = 0; i < n_rods; ++i)
     {
-      pzl->state[i] = st + n_disks * i;
+      pzl->state[i] = st + (size_t)n_disks * i;
     }
 
   for (uint32_t i = 0; i < n_disks; ++i)
     {
       pzl->state[0][i] = n_disks - i;
     }
+  if (n_rods > 0)
+    {
+      pzl->heights[0] = n_disks;
+    }
 
   pzl->n_rods = n_rods;
   pzl->n_disks = n_disks;
+  pzl->complete_rod = n_rods > 0 && n_disks > 0 ? 0 : HANOI_INCOMPLETE;
 
   return HANOI_INIT_OK;
 }
 
-void
-hanoi_free (struct hanoi_puzzle *pzl)
+/**
+ * @brief Initializes a `struct hanoi_puzzle`. A succsessfull init must be freed using `hanoi_free`.
+ * The puzzle is made with a single allocation, see `hanoi_init_in`.
+ *
+ * @param pzl Target `struct hanoi_puzzle`.
+ * @param n_rods Amount of rods in the puzzle.
+ * @param n_disks Amount of disks in the puzzle.
+ * @return HANOI_INIT_OK - Init successful.
+ * @return HANOI_INIT_INVALID_N_RODS_VALUE - The value of `n_rods` was set to `HANOI_INCOMPLATE`.
+ * @return HANOI_INIT_SYSTEM_ERROR - System failure during init. Check `errno`.
+ */
+enum hanoi_init_response
+hanoi_init (struct hanoi_puzzle *pzl, const uint32_t n_rods, const uint32_t n_disks)
 {
-  free (pzl->state[0]);
-  free (pzl->state);
-}
+  if (n_rods == HANOI_INCOMPLETE)
+    {
+      return HANOI_INIT_INVALID_N_RODS_VALUE;
+    }
 
-static uint32_t
-top_index (const struct hanoi_puzzle *pzl, const uint32_t i)
-{
-  if (pzl->state[i][0] == 0)
+  const size_t size = hanoi_storage_size (n_rods, n_disks);
+  if (size == SIZE_MAX)
     {
-      return 0;
+      errno = ENOMEM;
+      return HANOI_INIT_SYSTEM_ERROR;
     }
 
-  uint32_t j = 0;
-  while (pzl->state[i][++j] != 0)
+  void *storage = malloc (size);
+  if (storage == NULL)
     {
+      return HANOI_INIT_SYSTEM_ERROR;
     }
 
-  return j;
+  return hanoi_init_in (pzl, storage, n_rods, n_disks);
+}
+
+void
+hanoi_free (struct hanoi_puzzle *pzl)
+{
+  free (pzl->state);
 }
 
 /**
@@ -86,45 +134,59 @@ top_index (const struct hanoi_puzzle *pzl, const uint32_t i)
 bool
 hanoi_move (struct hanoi_puzzle *pzl, const uint32_t src_i, const uint32_t des_i)
 {
-  const uint32_t src_j = top_index (pzl, src_i);
+  const uint32_t src_j = pzl->heights[src_i];
+
+  HANOI_STATS_COUNT (HANOI_STATS_MOVES, 1);
 
   if (src_j == 0)
     {
+      HANOI_STATS_COUNT (HANOI_STATS_MOVES_REJECTED, 1);
       return false;
     }
 
   const uint32_t src = pzl->state[src_i][src_j - 1];
-  const uint32_t des_j = top_index (pzl, des_i);
+  const uint32_t des_j = pzl->heights[des_i];
 
-  if (des_j == 0)
-    {
-      pzl->state[src_i][src_j - 1] = 0;
-      pzl->state[des_i][des_j] = src;
-      return true;
-    }
-
-  const uint32_t des = pzl->state[des_i][des_j - 1];
-
-  if (src < des)
+  if (des_j == 0 || src < pzl->state[des_i][des_j - 1])
     {
       pzl->state[src_i][src_j - 1] = 0;
       pzl->state[des_i][des_j] = src;
+      pzl->heights[src_i] = src_j - 1;
+      pzl->heights[des_i] = des_j + 1;
+      /* Only the destination can hold every disk after the move. */
+      pzl->complete_rod = des_j + 1 == pzl->n_disks ? des_i : HANOI_INCOMPLETE;
       return true;
     }
 
+  HANOI_STATS_COUNT (HANOI_STATS_MOVES_REJECTED, 1);
   return false;
 }
 
 bool
 hanoi_empty_rod (const struct hanoi_puzzle *pzl, const uint32_t i)
 {
-  return pzl->state[i][0] == 0;
+  return pzl->heights[i] == 0;
+}
+
+/**
+ * @brief Gets the disk on top of a rod.
+ *
+ * @param pzl
+ * @param i Index of the rod.
+ * @return uint32_t Size of the top disk or 0 if the rod is empty.
+ */
+uint32_t
+hanoi_top_disk (const struct hanoi_puzzle *pzl, const uint32_t i)
+{
+  const uint32_t j = pzl->heights[i];
+  return j == 0 ? 0 : pzl->state[i][j - 1];
 }
 
 /**
  * @brief Checks if a `struct hanoi_puzzle` is completed. A complete state is defined as one where
  * all disks are on the same rod, the largest disk is at the bottom and all other disks are on top
- * of a disk of a size one greater than it.
+ * of a disk of a size one greater than it. In a legal state that is any rod holding every disk,
+ * which `hanoi_move` keeps track of.
  *
  * @param pzl
  * @return uint32_t The index of the rod where all disks resides or `HANOI_INCOMPLETE` if the puzzle
@@ -133,31 +195,215 @@ hanoi_empty_rod (const struct hanoi_puzzle *pzl, const uint32_t i)
 uint32_t
 hanoi_complete (const struct hanoi_puzzle *pzl)
 {
-  uint32_t filled_rod = HANOI_INCOMPLETE;
+  return pzl->complete_rod;
+}
 
-  for (uint32_t i = 0; i < pzl->n_rods; ++i)
+/**
+ * @brief Replaces the state of a puzzle with `cells`, laid out like `state`: `n_disks` cells per
+ * rod, bottom first, padded with zeros. The heights and the completed rod are recomputed.
+ *
+ * @param pzl Target `struct hanoi_puzzle`.
+ * @param cells `n_rods * n_disks` cells.
+ * @return true - The state was loaded.
+ * @return false - `cells` is not a legal state, `pzl` is left unspecified and `errno` is set to
+ * `EINVAL`. If memory for the check could not be allocated `errno` is set by `malloc`.
+ */
+bool
+hanoi_load_state (struct hanoi_puzzle *pzl, const uint32_t *cells)
+{
+  uint64_t small[64] = { 0 };
+  uint64_t *seen = small;
+
+  if (pzl->n_disks > sizeof (small) * 8)
     {
-      if (!hanoi_empty_rod (pzl, i))
+      seen = calloc ((pzl->n_disks + 63) / 64, sizeof (uint64_t));
+      if (seen == NULL)
         {
-          if (filled_rod != HANOI_INCOMPLETE)
-            {
-              return HANOI_INCOMPLETE;
-            }
-          else
+          return false;
+        }
+    }
+
+  bool legal = true;
+  uint32_t total = 0;
+
+  pzl->complete_rod = HANOI_INCOMPLETE;
+
+  for (uint32_t i = 0; i < pzl->n_rods && legal; ++i)
+    {
+      const uint32_t *rod = cells + (size_t)pzl->n_disks * i;
+      uint32_t j = 0;
+
+      for (; j < pzl->n_disks && rod[j] != 0; ++j)
+        {
+          const uint32_t d = rod[j] - 1;
+
+          if (rod[j] > pzl->n_disks || (j > 0 && rod[j] >= rod[j - 1])
+              || (seen[d / 64] >> (d % 64) & 1))
             {
-              filled_rod = i;
-              uint32_t j = 0;
-
-              for (; j < pzl->n_disks && pzl->state[i][j] == pzl->n_disks - j; ++j)
-                {
-                }
-              if (j != pzl->n_disks)
-                {
-                  return HANOI_INCOMPLETE;
-                }
+              legal = false;
+              break;
             }
+          seen[d / 64] |= (uint64_t)1 << (d % 64);
+          pzl->state[i][j] = rod[j];
+        }
+
+      pzl->heights[i] = j;
+      total += j;
+
+      for (; j < pzl->n_disks && legal; ++j)
+        {
+          legal = rod[j] == 0;
+          pzl->state[i][j] = 0;
+        }
+
+      if (pzl->heights[i] == pzl->n_disks && pzl->n_disks > 0)
+        {
+          pzl->complete_rod = i;
+        }
+    }
+
+  if (seen != small)
+    {
+      free (seen);
+    }
+
+  if (!legal || total != pzl->n_disks)
+    {
+      errno = EINVAL;
+      return false;
+    }
+
+  return true;
+}
+
+static bool
+rank_fits (const uint32_t n_rods, const uint32_t n_disks)
+{
+  if (n_disks == 0 || n_rods <= 1)
+    {
+      return true;
+    }
+
+  uint64_t p = 1;
+
+  for (uint32_t i = 1; i < n_disks; ++i)
+    {
+      if (__builtin_mul_overflow (p, n_rods, &p))
+        {
+          return false;
+        }
+    }
+
+  /* The largest rank is n_rods^n_disks - 1 = (p - 1) * n_rods + n_rods - 1. */
+  uint64_t max;
+  return !__builtin_mul_overflow (p - 1, n_rods, &max)
+         && !__builtin_add_overflow (max, n_rods - 1, &max);
+}
+
+/**
+ * @brief Maps the state of a `struct hanoi_puzzle` to an integer in [0, n_rods^n_disks). Digit
+ * `d - 1` in base `n_rods` is the index of the rod disk `d` is on, so the layout of `hanoi_init`
+ * has rank 0.
+ *
+ * @param pzl
+ * @param rank Receives the rank.
+ * @return true - `rank` was set.
+ * @return false - n_rods^n_disks does not fit in 64 bits.
+ */
+bool
+hanoi_rank (const struct hanoi_puzzle *pzl, uint64_t *rank)
+{
+  if (!rank_fits (pzl->n_rods, pzl->n_disks))
+    {
+      return false;
+    }
+
+  if (pzl->n_rods <= 1)
+    {
+      *rank = 0;
+      return true;
+    }
+
+  uint32_t rods[pzl->n_disks];
+
+  for (uint32_t i = 0; i < pzl->n_rods; ++i)
+    {
+      for (uint32_t j = 0; j < pzl->heights[i]; ++j)
+        {
+          rods[pzl->state[i][j] - 1] = i;
+        }
+    }
+
+  uint64_t r = 0;
+
+  for (uint32_t d = pzl->n_disks; d > 0; --d)
+    {
+      r = r * pzl->n_rods + rods[d - 1];
+    }
+
+  *rank = r;
+  return true;
+}
+
+/**
+ * @brief Sets the state of a `struct hanoi_puzzle` from a rank. See `hanoi_rank`.
+ *
+ * @param pzl An initialized `struct hanoi_puzzle`.
+ * @param rank
+ * @return true - State was updated.
+ * @return false - `rank` is not less than n_rods^n_disks.
+ */
+bool
+hanoi_unrank (struct hanoi_puzzle *pzl, uint64_t rank)
+{
+  if (pzl->n_rods <= 1)
+    {
+      return rank == 0;
+    }
+
+  if (!rank_fits (pzl->n_rods, pzl->n_disks))
+    {
+      return false;
+    }
+
+  uint32_t rods[pzl->n_disks];
+
+  for (uint32_t d = 0; d < pzl->n_disks; ++d)
+    {
+      rods[d] = rank % pzl->n_rods;
+      rank /= pzl->n_rods;
+    }
+
+  if (rank != 0)
+    {
+      return false;
+    }
+
+  for (uint32_t i = 0; i < pzl->n_rods; ++i)
+    {
+      pzl->heights[i] = 0;
+    }
+
+  for (uint32_t d = pzl->n_disks; d > 0; --d)
+    {
+      const uint32_t i = rods[d - 1];
+      pzl->state[i][pzl->heights[i]++] = d;
+    }
+
+  pzl->complete_rod = HANOI_INCOMPLETE;
+
+  for (uint32_t i = 0; i < pzl->n_rods; ++i)
+    {
+      for (uint32_t j = pzl->heights[i]; j < pzl->n_disks; ++j)
+        {
+          pzl->state[i][j] = 0;
+        }
+
+      if (pzl->n_disks > 0 && pzl->heights[i] == pzl->n_disks)
+        {
+          pzl->complete_rod = i;
         }
     }
 
-  return filled_rod;
+  return true;
 }
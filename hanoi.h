@@ -1,7 +1,9 @@
+
 #ifndef HANOI_H
 #define HANOI_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define HANOI_INCOMPLETE ((uint32_t)-1)
@@ -11,6 +13,8 @@ struct hanoi_puzzle
   uint32_t n_rods;
   uint32_t n_disks;
   uint32_t **state;
+  uint32_t *heights;
+  uint32_t complete_rod;
 };
 
 enum hanoi_init_response
@@ -18,8 +22,16 @@ enum hanoi_init_response
   HANOI_INIT_OK,
   HANOI_INIT_INVALID_N_RODS_VALUE,
   HANOI_INIT_SYSTEM_ERROR,
+  HANOI_INIT_UNSUPPORTED_SIZE,
 };
 
+size_t
+hanoi_storage_size (const uint32_t n_rods, const uint32_t n_disks);
+
+enum hanoi_init_response
+hanoi_init_in (struct hanoi_puzzle *pzl, void *storage, const uint32_t n_rods,
+               const uint32_t n_disks);
+
 enum hanoi_init_response
 hanoi_init (struct hanoi_puzzle *pzl, const uint32_t n_rods, const uint32_t n_disks);
 
@@ -32,7 +44,19 @@ hanoi_move (struct hanoi_puzzle *pzl, const uint32_t src_i, const uint32_t des_i
 bool
 hanoi_empty_rod (const struct hanoi_puzzle *pzl, const uint32_t i);
 
+uint32_t
+hanoi_top_disk (const struct hanoi_puzzle *pzl, const uint32_t i);
+
 uint32_t
 hanoi_complete (const struct hanoi_puzzle *pzl);
 
+bool
+hanoi_load_state (struct hanoi_puzzle *pzl, const uint32_t *cells);
+
+bool
+hanoi_rank (const struct hanoi_puzzle *pzl, uint64_t *rank);
+
+bool
+hanoi_unrank (struct hanoi_puzzle *pzl, uint64_t rank);
+
 #endif /* HANOI_H */
\ No newline at end of file
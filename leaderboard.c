@@ -0,0 +1,624 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "leaderboard.h"
+#include "record.h"
+#include "segment.h"
+
+#define MAX_USERNAME_LEN HANOI_RECORD_MAX_USERNAME_LEN
+#define INITIAL_REBUILD_CAP 1024
+
+struct leaderboard_header
+{
+  uint64_t magic;
+  uint64_t n_entries;
+};
+
+static char *
+leaderboard_path (const char *directory, const char *extension)
+{
+  const size_t len
+      = strlen (directory) + 1 + strlen (HANOI_LEADERBOARD_FILENAME) + strlen (extension) + 1;
+  char *path = malloc (len);
+
+  if (path != NULL)
+    {
+      snprintf (path, len, "%s/%s%s", directory, HANOI_LEADERBOARD_FILENAME, extension);
+    }
+
+  return path;
+}
+
+static int
+compare_key (const uint32_t n_rods, const uint32_t n_disks, const char *username,
+             const struct hanoi_leaderboard_entry *entry)
+{
+  if (n_rods != entry->n_rods)
+    {
+      return n_rods < entry->n_rods ? -1 : 1;
+    }
+  if (n_disks != entry->n_disks)
+    {
+      return n_disks < entry->n_disks ? -1 : 1;
+    }
+
+  return strncmp (username, entry->username, MAX_USERNAME_LEN);
+}
+
+static int
+compare_entries (const void *a, const void *b)
+{
+  const struct hanoi_leaderboard_entry *entry = a;
+
+  return compare_key (entry->n_rods, entry->n_disks, entry->username, b);
+}
+
+/**
+ * @brief Index of the first entry that is not less than the key.
+ */
+static size_t
+lower_bound (const struct hanoi_leaderboard_entry *entries, const size_t n_entries,
+             const uint32_t n_rods, const uint32_t n_disks, const char *username)
+{
+  size_t low = 0;
+  size_t high = n_entries;
+
+  while (low < high)
+    {
+      const size_t mid = low + (high - low) / 2;
+
+      if (compare_key (n_rods, n_disks, username, &entries[mid]) > 0)
+        {
+          low = mid + 1;
+        }
+      else
+        {
+          high = mid;
+        }
+    }
+
+  return low;
+}
+
+static void
+merge_entry (struct hanoi_leaderboard_entry *entry, const struct hanoi_leaderboard_entry *other)
+{
+  entry->games += other->games;
+
+  if (other->best_duration < entry->best_duration)
+    {
+      entry->best_duration = other->best_duration;
+    }
+  if (other->best_moves < entry->best_moves)
+    {
+      entry->best_moves = other->best_moves;
+    }
+}
+
+/**
+ * @brief Maps an open leaderboard file. An empty file is an empty leaderboard.
+ */
+static bool
+map_leaderboard (struct hanoi_leaderboard *leaderboard, const int fd)
+{
+  struct stat st;
+  if (fstat (fd, &st) == -1)
+    {
+      return false;
+    }
+
+  leaderboard->map = NULL;
+  leaderboard->map_len = st.st_size;
+  leaderboard->entries = NULL;
+  leaderboard->n_entries = 0;
+
+  if (leaderboard->map_len == 0)
+    {
+      return true;
+    }
+
+  if (leaderboard->map_len < sizeof (struct leaderboard_header))
+    {
+      errno = EINVAL;
+      return false;
+    }
+
+  leaderboard->map = mmap (NULL, leaderboard->map_len, PROT_READ, MAP_SHARED, fd, 0);
+  if (leaderboard->map == MAP_FAILED)
+    {
+      leaderboard->map = NULL;
+      return false;
+    }
+
+  const struct leaderboard_header *header = leaderboard->map;
+  const size_t max_entries = (leaderboard->map_len - sizeof (*header))
+                             / sizeof (struct hanoi_leaderboard_entry);
+
+  if (header->magic != HANOI_LEADERBOARD_MAGIC || header->n_entries > max_entries)
+    {
+      munmap (leaderboard->map, leaderboard->map_len);
+      leaderboard->map = NULL;
+      errno = EINVAL;
+      return false;
+    }
+
+  leaderboard->entries = (const struct hanoi_leaderboard_entry *)(header + 1);
+  leaderboard->n_entries = header->n_entries;
+
+  return true;
+}
+
+/**
+ * @brief Takes the lock every writer of the leaderboard in `directory` holds. Readers need no
+ * lock since a written file is never changed, only replaced by renaming a new one over it.
+ */
+static int
+lock_directory (const char *directory)
+{
+  const int fd = open (directory, O_RDONLY | O_DIRECTORY);
+  if (fd == -1)
+    {
+      return -1;
+    }
+
+  if (flock (fd, LOCK_EX) == -1)
+    {
+      const int error = errno;
+      close (fd);
+      errno = error;
+      return -1;
+    }
+
+  return fd;
+}
+
+/**
+ * @brief Replaces the leaderboard with `entries`, given as up to three sorted parts, by writing a
+ * new file next to it and renaming it over the old one.
+ */
+static bool
+write_leaderboard (const char *directory, const struct iovec *parts, const int n_parts)
+{
+  char *path = leaderboard_path (directory, "");
+  char *tmp_path = leaderboard_path (directory, ".tmp");
+  struct leaderboard_header header = { .magic = HANOI_LEADERBOARD_MAGIC, .n_entries = 0 };
+  struct iovec iov[4] = { { .iov_base = &header, .iov_len = sizeof (header) } };
+  bool ok = false;
+
+  for (int i = 0; i < n_parts; ++i)
+    {
+      iov[i + 1] = parts[i];
+      header.n_entries += parts[i].iov_len / sizeof (struct hanoi_leaderboard_entry);
+    }
+
+  const int fd = path != NULL && tmp_path != NULL
+                     ? open (tmp_path, O_WRONLY | O_CREAT | O_TRUNC,
+                             S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)
+                     : -1;
+
+  if (fd != -1)
+    {
+      ok = true;
+
+      for (int i = 0; ok && i < n_parts + 1; ++i)
+        {
+          const uint8_t *data = iov[i].iov_base;
+          size_t len = iov[i].iov_len;
+
+          while (ok && len > 0)
+            {
+              const ssize_t n = write (fd, data, len);
+              ok = n > 0;
+              data += ok ? n : 0;
+              len -= ok ? n : 0;
+            }
+        }
+
+      const int error = errno;
+      close (fd);
+      errno = error;
+
+      ok = ok && rename (tmp_path, path) != -1;
+    }
+
+  free (path);
+  free (tmp_path);
+
+  return ok;
+}
+
+/**
+ * @brief Maps the leaderboard of a records directory, see `hanoi_set_records_directory`. A
+ * directory without a leaderboard has an empty one. A successfull open must be closed using
+ * `hanoi_leaderboard_close`.
+ *
+ * @param leaderboard Target `struct hanoi_leaderboard`.
+ * @param directory
+ * @return true - The leaderboard was opened.
+ * @return false - The leaderboard is broken or a system call failed. Check `errno`.
+ */
+bool
+hanoi_leaderboard_open (struct hanoi_leaderboard *leaderboard, const char *directory)
+{
+  char *path = leaderboard_path (directory, "");
+  if (path == NULL)
+    {
+      return false;
+    }
+
+  const int fd = open (path, O_RDONLY);
+  free (path);
+
+  if (fd == -1)
+    {
+      if (errno != ENOENT)
+        {
+          return false;
+        }
+
+      *leaderboard = (struct hanoi_leaderboard){ 0 };
+      return true;
+    }
+
+  const bool ok = map_leaderboard (leaderboard, fd);
+  const int error = errno;
+  close (fd);
+  errno = error;
+
+  return ok;
+}
+
+void
+hanoi_leaderboard_close (struct hanoi_leaderboard *leaderboard)
+{
+  if (leaderboard->map != NULL)
+    {
+      munmap (leaderboard->map, leaderboard->map_len);
+    }
+}
+
+/**
+ * @brief Looks up the results of one user on one size of puzzle in O(log n).
+ *
+ * @return The entry, or NULL if the user has not completed that size.
+ */
+const struct hanoi_leaderboard_entry *
+hanoi_leaderboard_find (const struct hanoi_leaderboard *leaderboard, const uint32_t n_rods,
+                        const uint32_t n_disks, const char *username)
+{
+  const size_t i = lower_bound (leaderboard->entries, leaderboard->n_entries, n_rods, n_disks,
+                                username);
+
+  if (i < leaderboard->n_entries
+      && compare_key (n_rods, n_disks, username, &leaderboard->entries[i]) == 0)
+    {
+      return &leaderboard->entries[i];
+    }
+
+  return NULL;
+}
+
+/**
+ * @brief Finds the entries of every user on one size of puzzle, sorted by username.
+ *
+ * @param leaderboard
+ * @param n_rods
+ * @param n_disks
+ * @param n_entries Set to the amount of entries.
+ * @return The first entry.
+ */
+const struct hanoi_leaderboard_entry *
+hanoi_leaderboard_range (const struct hanoi_leaderboard *leaderboard, const uint32_t n_rods,
+                         const uint32_t n_disks, size_t *n_entries)
+{
+  const size_t first = lower_bound (leaderboard->entries, leaderboard->n_entries, n_rods,
+                                    n_disks, "");
+  size_t last = first;
+
+  while (last < leaderboard->n_entries && leaderboard->entries[last].n_rods == n_rods
+         && leaderboard->entries[last].n_disks == n_disks)
+    {
+      ++last;
+    }
+
+  *n_entries = last - first;
+
+  return leaderboard->entries + first;
+}
+
+/**
+ * @brief Adds a completed game to the leaderboard of a records directory. The leaderboard is
+ * rewritten with the entry of the user and size added or merged, so a leaderboard already open
+ * keeps a consistent view of the file it mapped.
+ *
+ * @param directory
+ * @param n_rods
+ * @param n_disks
+ * @param username
+ * @param duration Duration of the game.
+ * @param moves Amount of moves of the game.
+ * @return true - The game was added.
+ * @return false - The leaderboard is broken or a system call failed. Check `errno`.
+ */
+bool
+hanoi_leaderboard_add (const char *directory, const uint32_t n_rods, const uint32_t n_disks,
+                       const char *username, const uint64_t duration, const uint64_t moves)
+{
+  const int lock_fd = lock_directory (directory);
+  if (lock_fd == -1)
+    {
+      return false;
+    }
+
+  char *path = leaderboard_path (directory, "");
+  const int fd = path != NULL ? open (path, O_RDONLY) : -1;
+  struct hanoi_leaderboard leaderboard = { 0 };
+  bool ok = fd != -1 ? map_leaderboard (&leaderboard, fd) : path != NULL && errno == ENOENT;
+
+  struct hanoi_leaderboard_entry entry = {
+    .n_rods = n_rods,
+    .n_disks = n_disks,
+    .games = 1,
+    .best_duration = duration,
+    .best_moves = moves,
+  };
+  memcpy (entry.username, username, strnlen (username, MAX_USERNAME_LEN));
+
+  if (ok)
+    {
+      const size_t i = lower_bound (leaderboard.entries, leaderboard.n_entries, n_rods, n_disks,
+                                    entry.username);
+
+      /* An entry of a known user and size is replaced by the merged one instead of written in
+         place, which could show a reader half of an entry. */
+      const bool known = i < leaderboard.n_entries
+                         && compare_entries (&entry, &leaderboard.entries[i]) == 0;
+
+      if (known)
+        {
+          const struct hanoi_leaderboard_entry game = entry;
+          entry = leaderboard.entries[i];
+          merge_entry (&entry, &game);
+        }
+
+      const struct iovec parts[] = {
+        { .iov_base = (void *)leaderboard.entries, .iov_len = i * sizeof (entry) },
+        { .iov_base = &entry, .iov_len = sizeof (entry) },
+        { .iov_base = (void *)(leaderboard.entries + i + known),
+          .iov_len = (leaderboard.n_entries - i - known) * sizeof (entry) },
+      };
+
+      ok = write_leaderboard (directory, parts, 3);
+    }
+
+  const int error = errno;
+  hanoi_leaderboard_close (&leaderboard);
+  if (fd != -1)
+    {
+      close (fd);
+    }
+  free (path);
+  close (lock_fd);
+  errno = error;
+
+  return ok;
+}
+
+struct rebuild
+{
+  struct hanoi_leaderboard_entry *entries;
+  size_t len;
+  size_t cap;
+};
+
+/**
+ * @brief Sorts the entries and merges the ones of the same user and size.
+ */
+static void
+rebuild_merge (struct rebuild *rebuild)
+{
+  if (rebuild->len == 0)
+    {
+      return;
+    }
+
+  qsort (rebuild->entries, rebuild->len, sizeof (*rebuild->entries), compare_entries);
+
+  size_t n = 0;
+  for (size_t i = 1; i < rebuild->len; ++i)
+    {
+      if (compare_entries (&rebuild->entries[i], &rebuild->entries[n]) == 0)
+        {
+          merge_entry (&rebuild->entries[n], &rebuild->entries[i]);
+        }
+      else
+        {
+          rebuild->entries[++n] = rebuild->entries[i];
+        }
+    }
+  rebuild->len = n + 1;
+}
+
+static bool
+rebuild_add (struct rebuild *rebuild, const struct hanoi_record *record, const uint64_t duration)
+{
+  if (rebuild->len == rebuild->cap)
+    {
+      rebuild_merge (rebuild);
+    }
+
+  /* Only grow when merging did not make enough room. */
+  if (rebuild->cap == 0 || rebuild->len > rebuild->cap / 2)
+    {
+      const size_t cap = rebuild->cap > 0 ? 2 * rebuild->cap : INITIAL_REBUILD_CAP;
+      struct hanoi_leaderboard_entry *entries
+          = realloc (rebuild->entries, cap * sizeof (*entries));
+
+      if (entries == NULL)
+        {
+          return false;
+        }
+      rebuild->entries = entries;
+      rebuild->cap = cap;
+    }
+
+  struct hanoi_leaderboard_entry *entry = &rebuild->entries[rebuild->len++];
+
+  *entry = (struct hanoi_leaderboard_entry){
+    .n_rods = hanoi_record_n_rods (record),
+    .n_disks = hanoi_record_n_disks (record),
+    .games = 1,
+    .best_duration = duration,
+    .best_moves = hanoi_record_n_moves (record),
+  };
+  memcpy (entry->username, hanoi_record_username (record), MAX_USERNAME_LEN);
+
+  return true;
+}
+
+static bool
+has_extension (const char *name, const char *extension)
+{
+  const size_t len = strlen (name);
+  const size_t extension_len = strlen (extension);
+
+  return len > extension_len && strcmp (name + len - extension_len, extension) == 0;
+}
+
+static bool
+rebuild_file (struct rebuild *rebuild, const char *path)
+{
+  struct hanoi_record_file file;
+
+  /* Records that cannot be read are not counted, like the ones that were never completed. */
+  if (!hanoi_record_open (&file, path))
+    {
+      return errno == EINVAL;
+    }
+
+  bool ok = true;
+
+  if (hanoi_record_checksum_valid (&file.record))
+    {
+      struct hanoi_record_iterator it;
+      struct hanoi_record_move move = { 0 };
+
+      hanoi_record_iterator_init (&it, &file.record);
+      while (hanoi_record_iterator_next (&it, &move))
+        {
+        }
+
+      ok = rebuild_add (rebuild, &file.record, move.duration);
+    }
+
+  hanoi_record_close (&file);
+
+  return ok;
+}
+
+static bool
+rebuild_segment (struct rebuild *rebuild, const char *path)
+{
+  struct hanoi_segment segment;
+
+  if (!hanoi_segment_open (&segment, path))
+    {
+      return errno == EINVAL;
+    }
+
+  bool ok = true;
+
+  for (size_t i = 0; ok && i < segment.n_entries; ++i)
+    {
+      struct hanoi_record record;
+
+      if (hanoi_segment_record (&segment, i, &record) && hanoi_record_checksum_valid (&record))
+        {
+          ok = rebuild_add (rebuild, &record, segment.entries[i].duration);
+        }
+    }
+
+  hanoi_segment_close (&segment);
+
+  return ok;
+}
+
+/**
+ * @brief Replaces the leaderboard of a records directory with one made from every completed record
+ * in it, for directories with records from before the leaderboard or a leaderboard that broke.
+ *
+ * @param directory
+ * @return true - The leaderboard was rebuilt.
+ * @return false - A system call failed. Check `errno`.
+ */
+bool
+hanoi_leaderboard_rebuild (const char *directory)
+{
+  const int lock_fd = lock_directory (directory);
+  if (lock_fd == -1)
+    {
+      return false;
+    }
+
+  DIR *dir = opendir (directory);
+  struct rebuild rebuild = { 0 };
+  bool ok = dir != NULL;
+
+  for (struct dirent *dirent; ok && (dirent = readdir (dir)) != NULL;)
+    {
+      const bool is_file = has_extension (dirent->d_name, ".hanoi-puzzle");
+      const bool is_segment = has_extension (dirent->d_name, ".hanoi-segment");
+
+      if (!is_file && !is_segment)
+        {
+          continue;
+        }
+
+      const size_t len = strlen (directory) + 1 + strlen (dirent->d_name) + 1;
+      char *path = malloc (len);
+      if (path == NULL)
+        {
+          ok = false;
+          break;
+        }
+      snprintf (path, len, "%s/%s", directory, dirent->d_name);
+
+      ok = is_file ? rebuild_file (&rebuild, path) : rebuild_segment (&rebuild, path);
+      free (path);
+    }
+
+  if (ok)
+    {
+      rebuild_merge (&rebuild);
+
+      const struct iovec part = {
+        .iov_base = rebuild.entries,
+        .iov_len = rebuild.len * sizeof (*rebuild.entries),
+      };
+
+      ok = write_leaderboard (directory, &part, 1);
+    }
+
+  const int error = errno;
+  if (dir != NULL)
+    {
+      closedir (dir);
+    }
+  free (rebuild.entries);
+  close (lock_fd);
+  errno = error;
+
+  return ok;
+}
@@ -0,0 +1,62 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "record.h"
+
+/* Kept in the records directory next to the records it summarizes. */
+#define HANOI_LEADERBOARD_FILENAME "records.hanoi-leaderboard"
+/* "HNOILDBR" */
+#define HANOI_LEADERBOARD_MAGIC 0x5242444c494f4e48
+
+/**
+ * Best results of a user on one size of puzzle. Entries are sorted by `n_rods`, `n_disks` and then
+ * `username`. The best duration and the best amount of moves may come from different games.
+ */
+struct hanoi_leaderboard_entry
+{
+  uint32_t n_rods;
+  uint32_t n_disks;
+  char username[HANOI_RECORD_MAX_USERNAME_LEN];
+  uint64_t games;
+  uint64_t best_duration;
+  uint64_t best_moves;
+};
+
+/**
+ * Leaderboard file mapped into memory, see `hanoi_leaderboard_open`. Updates replace the file
+ * instead of changing it, so the entries stay as they were opened until the leaderboard is closed.
+ */
+struct hanoi_leaderboard
+{
+  void *map;
+  size_t map_len;
+  const struct hanoi_leaderboard_entry *entries;
+  size_t n_entries;
+};
+
+bool
+hanoi_leaderboard_open (struct hanoi_leaderboard *leaderboard, const char *directory);
+
+void
+hanoi_leaderboard_close (struct hanoi_leaderboard *leaderboard);
+
+const struct hanoi_leaderboard_entry *
+hanoi_leaderboard_find (const struct hanoi_leaderboard *leaderboard, const uint32_t n_rods,
+                        const uint32_t n_disks, const char *username);
+
+const struct hanoi_leaderboard_entry *
+hanoi_leaderboard_range (const struct hanoi_leaderboard *leaderboard, const uint32_t n_rods,
+                         const uint32_t n_disks, size_t *n_entries);
+
+bool
+hanoi_leaderboard_add (const char *directory, const uint32_t n_rods, const uint32_t n_disks,
+                       const char *username, const uint64_t duration, const uint64_t moves);
+
+bool
+hanoi_leaderboard_rebuild (const char *directory);
+
+#endif /* LEADERBOARD_H */
\ No newline at end of file
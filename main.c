@@ -9,7 +9,10 @@
 #include <ncurses.h>
 
 #include "hanoi.h"
+#include "leaderboard.h"
 #include "record.h"
+#include "solve.h"
+#include "stats.h"
 
 #define error(...)                                                                                 \
   {                                                                                                \
@@ -23,6 +26,185 @@ center (const struct hanoi_puzzle *pzl, const int i)
   return i * (1 + 2 * pzl->n_disks) + (1 + 2 * (pzl->n_disks - 1)) / 2;
 }
 
+/**
+ * What the windows show, so a frame only redraws the rods, selector cells and status fields that
+ * changed since the last one instead of clearing and repainting the whole terminal.
+ */
+struct renderer
+{
+  WINDOW *game;
+  WINDOW *select;
+  WINDOW *status;
+  bool *dirty_rods;
+  bool drawn;
+  int selected_src;
+  int selected_des;
+  uint64_t tenths;
+  int moves;
+  char message[64];
+};
+
+static bool
+renderer_init (struct renderer *renderer, WINDOW *game, WINDOW *select, WINDOW *status,
+               const uint32_t n_rods)
+{
+  renderer->dirty_rods = malloc (n_rods * sizeof (renderer->dirty_rods[0]));
+  if (renderer->dirty_rods == NULL)
+    {
+      return false;
+    }
+
+  for (uint32_t i = 0; i < n_rods; ++i)
+    {
+      renderer->dirty_rods[i] = true;
+    }
+
+  renderer->game = game;
+  renderer->select = select;
+  renderer->status = status;
+  renderer->drawn = false;
+  renderer->selected_src = -1;
+  renderer->selected_des = -1;
+
+  return true;
+}
+
+static void
+renderer_free (struct renderer *renderer)
+{
+  free (renderer->dirty_rods);
+}
+
+/**
+ * @brief Marks a rod to be redrawn by the next frame. Called for both rods of every move.
+ */
+static void
+renderer_mark_rod (struct renderer *renderer, const uint32_t i)
+{
+  renderer->dirty_rods[i] = true;
+}
+
+static void
+draw_rod (struct renderer *renderer, const struct hanoi_puzzle *pzl, const int i)
+{
+  const int cx = center (pzl, i);
+  const int half_width = pzl->n_disks - 1;
+
+  for (int j = 0; j < pzl->n_disks; ++j)
+    {
+      const int y = pzl->n_disks - j - 1;
+      const int disk = pzl->state[i][j];
+
+      /* Every cell of the row is written, so what was there before needs no clearing. */
+      for (int x = cx - half_width; x <= cx + half_width; ++x)
+        {
+          const int dx = x < cx ? cx - x : x - cx;
+          const chtype ch = disk != 0 ? (dx < disk ? 'O' : ' ') : (dx == 0 ? '|' : ' ');
+          mvwaddch (renderer->game, y, x, ch);
+        }
+    }
+}
+
+/**
+ * @brief Brings the windows up to date with one `doupdate`, touching only what changed.
+ *
+ * @return true - Something was redrawn.
+ * @return false - The terminal already showed the current state.
+ */
+static bool
+renderer_frame (struct renderer *renderer, const struct hanoi_puzzle *pzl, const int selected_src,
+                const int selected_des, const uint64_t duration, const int moves,
+                const char *message)
+{
+  bool game_changed = false;
+  bool select_changed = false;
+  bool status_changed = false;
+
+  for (uint32_t i = 0; i < pzl->n_rods; ++i)
+    {
+      if (renderer->dirty_rods[i])
+        {
+          draw_rod (renderer, pzl, i);
+          renderer->dirty_rods[i] = false;
+          game_changed = true;
+        }
+    }
+
+  if (selected_src != renderer->selected_src || selected_des != renderer->selected_des)
+    {
+      if (renderer->selected_src != -1)
+        {
+          mvwaddch (renderer->select, 0, center (pzl, renderer->selected_src), ' ');
+        }
+      if (renderer->selected_des != -1)
+        {
+          mvwaddch (renderer->select, 0, center (pzl, renderer->selected_des), ' ');
+        }
+
+      if (selected_des == -1)
+        {
+          mvwaddch (renderer->select, 0, center (pzl, selected_src), 'v');
+        }
+      else
+        {
+          mvwaddch (renderer->select, 0, center (pzl, selected_src), '+');
+          mvwaddch (renderer->select, 0, center (pzl, selected_des), 'V');
+        }
+
+      renderer->selected_src = selected_src;
+      renderer->selected_des = selected_des;
+      select_changed = true;
+    }
+
+  /* The clock only shows tenths of a second, so most timer ticks draw nothing. */
+  const uint64_t tenths = duration / 100;
+
+  if (!renderer->drawn || tenths != renderer->tenths)
+    {
+      mvwprintw (renderer->status, 0, 0, "Time: %-10.1f", (double)tenths / 10);
+      renderer->tenths = tenths;
+      status_changed = true;
+    }
+
+  if (!renderer->drawn || moves != renderer->moves)
+    {
+      mvwprintw (renderer->status, 0, 16, "Moves: %-9d", moves);
+      renderer->moves = moves;
+      status_changed = true;
+    }
+
+  if (!renderer->drawn || strncmp (message, renderer->message, sizeof (renderer->message)) != 0)
+    {
+      mvwprintw (renderer->status, 1, 0, "%s", message);
+      wclrtoeol (renderer->status);
+      strncpy (renderer->message, message, sizeof (renderer->message));
+      status_changed = true;
+    }
+
+  renderer->drawn = true;
+
+  if (game_changed)
+    {
+      wnoutrefresh (renderer->game);
+    }
+  if (select_changed)
+    {
+      wnoutrefresh (renderer->select);
+    }
+  if (status_changed)
+    {
+      wnoutrefresh (renderer->status);
+    }
+
+  if (game_changed || select_changed || status_changed)
+    {
+      doupdate ();
+      return true;
+    }
+
+  return false;
+}
+
 static bool
 init_puzzle (struct hanoi_puzzle *pzl, const uint32_t n_rods, const uint32_t n_disks)
 {
@@ -36,6 +218,9 @@ init_puzzle (struct hanoi_puzzle *pzl, const uint32_t n_rods, const uint32_t n_d
     case HANOI_INIT_SYSTEM_ERROR:
       error ("%s\n", strerror (errno));
       return false;
+    case HANOI_INIT_UNSUPPORTED_SIZE:
+      error ("Unsupported puzzle size %ux%u\n", n_rods, n_disks);
+      return false;
     }
 }
 
@@ -45,6 +230,7 @@ print_help (const char *program)
   printf ("usage: %s\n", program);
   printf ("    [ --size=<rods,disks> ]\n");
   printf ("    [ --username=<name> ]\n");
+  printf ("    [ --rebuild-index ]\n");
   printf ("    [ --help ]\n");
 }
 
@@ -55,6 +241,7 @@ main (int argc, char **argv)
 
   struct hanoi_puzzle pzl;
   bool puzzle_is_initialized = false;
+  bool rebuild_index = false;
   char username[32];
 
   strncpy (username, "John Doe", sizeof (username));
@@ -80,6 +267,10 @@ main (int argc, char **argv)
       else if (sscanf (argv[i], "--username=%31s", username))
         {
         }
+      else if (strcmp (argv[i], "--rebuild-index") == 0)
+        {
+          rebuild_index = true;
+        }
       else if (sscanf (argv[i], "--help"))
         {
           print_help (argv[0]);
@@ -114,9 +305,33 @@ main (int argc, char **argv)
       return 1;
     }
 
+  if (rebuild_index)
+    {
+      const bool ok = hanoi_leaderboard_rebuild ("records");
+
+      if (!ok)
+        {
+          error ("%s\n", strerror (errno));
+        }
+      hanoi_free (&pzl);
+      return ok ? 0 : 1;
+    }
+
   hanoi_set_records_directory ("records");
 
+#ifdef HANOI_STATS
+  if (!hanoi_stats_install ("hanoi.stats"))
+    {
+      error ("%s\n", strerror (errno));
+    }
+#endif
+  hanoi_set_record_storage (HANOI_RECORD_STORAGE_SEGMENTS, 0);
+
   struct hanoi_recorder recorder;
+  const struct hanoi_recorder_options record_options = {
+    .flush = HANOI_FLUSH_INTERVAL,
+    .interval_ms = 500,
+  };
 
   if (!hanoi_new_recorder (&recorder, &pzl, username))
     {
@@ -124,6 +339,8 @@ main (int argc, char **argv)
       hanoi_free (&pzl);
       return 1;
     }
+  /* Keeps the disk off the input loop. If the thread cannot start the recorder writes directly. */
+  hanoi_recorder_start_async (&recorder, &record_options);
 
   initscr ();
   raw ();
@@ -138,18 +355,36 @@ main (int argc, char **argv)
   WINDOW *window_select = newwin (1, game_window_width, 1, 1);
   WINDOW *window_status = newwin (2, 32, pzl.n_disks + 3, 0);
 
+  struct renderer renderer;
+
+  if (!renderer_init (&renderer, window_game, window_select, window_status, pzl.n_rods))
+    {
+      delwin (window_game);
+      delwin (window_select);
+      delwin (window_status);
+      endwin ();
+      error ("%s\n", strerror (errno));
+      hanoi_free_recorder (&recorder);
+      hanoi_free (&pzl);
+      return 1;
+    }
+
   int last_complete_position = hanoi_complete (&pzl);
+  bool show_complete = false;
   int moves = 0;
   int selected_src = 0;
   int selected_des = -1;
   char *error_display = NULL;
+  char hint_display[64];
   uint64_t duration = 0;
   bool active = false;
+  /* When the last key was read, for the time until its frame is shown. */
+  uint64_t key_time = 0;
 
   struct timespec last_time;
 
-  mvwprintw (window_status, 0, 0, "Time: %.1f", (double)duration / (double)1e9);
-  mvwprintw (window_status, 0, 16, "Moves: %d", moves);
+  /* The windows are drawn over the cleared screen from here on, never cleared again. */
+  refresh ();
 
   while (1)
     {
@@ -160,15 +395,8 @@ main (int argc, char **argv)
           duration += (time.tv_sec - last_time.tv_sec) * 1000;
           duration += (time.tv_nsec - last_time.tv_nsec) / 1000000;
           last_time = time;
-
-          wclear (window_status);
-          mvwprintw (window_status, 0, 0, "Time: %.1f", (double)duration / (double)1e3);
-          mvwprintw (window_status, 0, 16, "Moves: %d", moves);
         }
 
-      wclear (window_game);
-      wclear (window_select);
-
       const uint32_t current_complete_position = hanoi_complete (&pzl);
 
       if (current_complete_position != HANOI_INCOMPLETE
@@ -176,11 +404,12 @@ main (int argc, char **argv)
         {
           active = false;
           last_complete_position = current_complete_position;
-          mvwprintw (window_status, 1, 0, "Complete!");
+          show_complete = true;
 
           if (!hanoi_recorder_write_checksum (&recorder))
             {
               error ("%s\n", strerror (errno));
+              renderer_free (&renderer);
               delwin (window_game);
               delwin (window_select);
               delwin (window_status);
@@ -189,11 +418,18 @@ main (int argc, char **argv)
               return 1;
             }
 
+          /* The game is recorded; the leaderboard can be rebuilt with `--rebuild-index`. */
+          if (recorder.leaderboard_error != 0)
+            {
+              error_display = "Leaderboard not updated";
+            }
+
           hanoi_free_recorder (&recorder);
 
           if (!hanoi_new_recorder (&recorder, &pzl, username))
             {
               error ("%s\n", strerror (errno));
+              renderer_free (&renderer);
               delwin (window_game);
               delwin (window_select);
               delwin (window_status);
@@ -201,57 +437,48 @@ main (int argc, char **argv)
               hanoi_free (&pzl);
               return 1;
             }
+          hanoi_recorder_start_async (&recorder, &record_options);
         }
 
-      if (error_display)
-        {
-          mvwprintw (window_status, 1, 0, error_display);
-        }
+      const char *message = error_display != NULL ? error_display
+                            : show_complete         ? "Complete!"
+                                                    : "";
 
-      for (int i = 0; i < pzl.n_rods; ++i)
+      if (renderer_frame (&renderer, &pzl, selected_src, selected_des, duration, moves, message))
         {
-          const int cx = center (&pzl, i);
-
-          for (int j = 0; j < pzl.n_disks; ++j)
-            {
-              const int y = pzl.n_disks - j - 1;
-
-              const uint32_t disk = pzl.state[i][j];
-              if (disk == 0)
-                {
-                  mvwaddch (window_game, y, cx, '|');
-                }
-              else
-                {
-                  for (int x = cx - disk + 1; x < cx + disk; ++x)
-                    {
-                      mvwaddch (window_game, y, x, 'O');
-                    }
-                }
-            }
+          HANOI_STATS_COUNT (HANOI_STATS_FRAMES, 1);
         }
 
-      if (selected_des == -1)
-        {
-          mvwaddch (window_select, 0, center (&pzl, selected_src), 'v');
-        }
-      else
+      if (key_time != 0)
         {
-          mvwaddch (window_select, 0, center (&pzl, selected_src), '+');
-          mvwaddch (window_select, 0, center (&pzl, selected_des), 'V');
+          HANOI_STATS_RECORD (HANOI_STATS_KEY_TO_FRAME_NS, HANOI_STATS_NOW () - key_time);
+          key_time = 0;
         }
 
-      refresh ();
-      wrefresh (window_game);
-      wrefresh (window_select);
-      wrefresh (window_status);
-
       const int c = getch ();
+      if (c != ERR)
+        {
+          key_time = HANOI_STATS_NOW ();
+        }
 
       if (c == 'q')
         {
           break;
         }
+      else if (c == 'h')
+        {
+          struct hanoi_hint hint;
+
+          error_display = NULL;
+
+          if (hanoi_solve_hint (&pzl, last_complete_position, &hint) && hint.n_moves > 0)
+            {
+              snprintf (hint_display, sizeof (hint_display), "Hint: %u -> %u, %llu left",
+                        hint.move.src_i + 1, hint.move.des_i + 1,
+                        (unsigned long long)hint.n_moves);
+              error_display = hint_display;
+            }
+        }
       else if (c == KEY_LEFT)
         {
           error_display = NULL;
@@ -306,9 +533,13 @@ main (int argc, char **argv)
                 {
                   if (hanoi_move (&pzl, selected_src, selected_des))
                     {
+                      renderer_mark_rod (&renderer, selected_src);
+                      renderer_mark_rod (&renderer, selected_des);
+
                       if (!active)
                         {
                           active = true;
+                          show_complete = false;
 
                           clock_gettime (CLOCK_MONOTONIC, &last_time);
                           moves = 0;
@@ -332,6 +563,7 @@ main (int argc, char **argv)
         }
     }
 
+  renderer_free (&renderer);
   delwin (window_game);
   delwin (window_select);
   delwin (window_status);
@@ -0,0 +1,268 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hanoi.h"
+#include "packed.h"
+
+/**
+ * @brief Initializes a `struct hanoi_packed` with all disks on the first rod. A successful init
+ * must be freed using `hanoi_packed_free`.
+ *
+ * Every disk takes ceil(log2(n_rods)) bits, so 3 rods with 100 million disks fit in 25 MB.
+ *
+ * @param pk Target `struct hanoi_packed`.
+ * @param n_rods Amount of rods in the puzzle.
+ * @param n_disks Amount of disks in the puzzle.
+ * @return HANOI_INIT_OK - Init successful.
+ * @return HANOI_INIT_INVALID_N_RODS_VALUE - The value of `n_rods` was set to `HANOI_INCOMPLATE`.
+ * @return HANOI_INIT_SYSTEM_ERROR - System failure during init. Check `errno`.
+ */
+enum hanoi_init_response
+hanoi_packed_init (struct hanoi_packed *pk, const uint32_t n_rods, const uint32_t n_disks)
+{
+  if (n_rods == HANOI_INCOMPLETE)
+    {
+      return HANOI_INIT_INVALID_N_RODS_VALUE;
+    }
+
+  pk->bits = n_rods <= 2 ? 1 : 32 - __builtin_clz (n_rods - 1);
+  pk->per_word = 64 / pk->bits;
+  pk->lows = 0;
+
+  for (uint32_t j = 0; j < pk->per_word; ++j)
+    {
+      pk->lows |= (uint64_t)1 << (j * pk->bits);
+    }
+
+  pk->highs = pk->lows << (pk->bits - 1);
+
+  pk->rods = calloc ((n_disks + pk->per_word - 1) / pk->per_word + 1, sizeof (pk->rods[0]));
+  if (pk->rods == NULL)
+    {
+      return HANOI_INIT_SYSTEM_ERROR;
+    }
+
+  pk->tops = calloc (2 * (size_t)n_rods + 1, sizeof (pk->tops[0]));
+  if (pk->tops == NULL)
+    {
+      free (pk->rods);
+      return HANOI_INIT_SYSTEM_ERROR;
+    }
+
+  pk->heights = pk->tops + n_rods;
+  pk->n_rods = n_rods;
+  pk->n_disks = n_disks;
+
+  if (n_rods > 0 && n_disks > 0)
+    {
+      pk->tops[0] = 1;
+      pk->heights[0] = n_disks;
+      pk->complete_rod = 0;
+    }
+  else
+    {
+      pk->complete_rod = HANOI_INCOMPLETE;
+    }
+
+  return HANOI_INIT_OK;
+}
+
+/**
+ * @brief Initializes a `struct hanoi_packed` with the state of another. A successful init must be
+ * freed using `hanoi_packed_free`.
+ *
+ * @param pk Target `struct hanoi_packed`.
+ * @param src Puzzle to copy.
+ * @return HANOI_INIT_OK - Init successful.
+ * @return HANOI_INIT_SYSTEM_ERROR - System failure during init. Check `errno`.
+ */
+enum hanoi_init_response
+hanoi_packed_init_copy (struct hanoi_packed *pk, const struct hanoi_packed *src)
+{
+  const enum hanoi_init_response response = hanoi_packed_init (pk, src->n_rods, src->n_disks);
+  if (response != HANOI_INIT_OK)
+    {
+      return response;
+    }
+
+  memcpy (pk->rods, src->rods,
+          ((src->n_disks + src->per_word - 1) / src->per_word + 1) * sizeof (pk->rods[0]));
+  memcpy (pk->tops, src->tops, 2 * (size_t)src->n_rods * sizeof (pk->tops[0]));
+  pk->complete_rod = src->complete_rod;
+
+  return HANOI_INIT_OK;
+}
+
+void
+hanoi_packed_free (struct hanoi_packed *pk)
+{
+  free (pk->rods);
+  free (pk->tops);
+}
+
+/**
+ * @brief Gets the rod a disk is on.
+ *
+ * @param pk
+ * @param disk Size of the disk, from 1 to `n_disks`.
+ * @return uint32_t Index of the rod.
+ */
+uint32_t
+hanoi_packed_rod (const struct hanoi_packed *pk, const uint32_t disk)
+{
+  const uint32_t d = disk - 1;
+  return (pk->rods[d / pk->per_word] >> (d % pk->per_word * pk->bits)) & ((1 << pk->bits) - 1);
+}
+
+static void
+set_rod (struct hanoi_packed *pk, const uint32_t disk, const uint32_t i)
+{
+  const uint32_t d = disk - 1;
+  const uint32_t shift = d % pk->per_word * pk->bits;
+  uint64_t *word = &pk->rods[d / pk->per_word];
+
+  *word = (*word & ~((((uint64_t)1 << pk->bits) - 1) << shift)) | ((uint64_t)i << shift);
+}
+
+/**
+ * Finds the smallest disk larger than `disk` on rod `i`, which has to exist. Compares a whole word
+ * of disks at a time: after xor with the rod index broadcast to every field, the fields of disks on
+ * the rod are zero, and the lowest zero field is found with the usual borrow trick.
+ */
+static uint32_t
+next_disk (const struct hanoi_packed *pk, const uint32_t disk, const uint32_t i)
+{
+  uint32_t w = disk / pk->per_word;
+  const uint64_t pattern = pk->lows * i;
+
+  /* Fields of `disk` and smaller disks are made nonzero, so they neither match nor borrow. */
+  const uint64_t skip = (disk % pk->per_word) * pk->bits;
+  uint64_t below = skip == 0 ? 0 : pk->lows & ((((uint64_t)1) << skip) - 1);
+
+  while (true)
+    {
+      const uint64_t x = (pk->rods[w] ^ pattern) | below;
+      const uint64_t z = pk->bits == 1 ? ~x & pk->lows : (x - pk->lows) & ~x & pk->highs;
+
+      if (z != 0)
+        {
+          return w * pk->per_word + __builtin_ctzll (z) / pk->bits + 1;
+        }
+
+      below = 0;
+      ++w;
+    }
+}
+
+/**
+ * @brief Moves a disk to a new rod. Same rules as `hanoi_move`. Finding the new top disk of the
+ * source rod scans the disks between the moved disk and it, a word at a time.
+ *
+ * @param pk A `struct hanoi_packed` where the move should take place.
+ * @param src_i Index of the source rod.
+ * @param des_i Index of the destination rod.
+ * @return true - State was updated.
+ * @return false - State did not update.
+ */
+bool
+hanoi_packed_move (struct hanoi_packed *pk, const uint32_t src_i, const uint32_t des_i)
+{
+  const uint32_t src = pk->tops[src_i];
+  const uint32_t des = pk->tops[des_i];
+
+  if (src == 0 || (des != 0 && des <= src))
+    {
+      return false;
+    }
+
+  set_rod (pk, src, des_i);
+
+  pk->heights[src_i] -= 1;
+  pk->heights[des_i] += 1;
+  pk->tops[des_i] = src;
+  pk->tops[src_i] = pk->heights[src_i] == 0 ? 0 : next_disk (pk, src, src_i);
+  pk->complete_rod = pk->heights[des_i] == pk->n_disks ? des_i : HANOI_INCOMPLETE;
+
+  return true;
+}
+
+bool
+hanoi_packed_empty_rod (const struct hanoi_packed *pk, const uint32_t i)
+{
+  return pk->heights[i] == 0;
+}
+
+uint32_t
+hanoi_packed_top_disk (const struct hanoi_packed *pk, const uint32_t i)
+{
+  return pk->tops[i];
+}
+
+/**
+ * @brief Checks if a `struct hanoi_packed` is completed. See `hanoi_complete`.
+ *
+ * @param pk
+ * @return uint32_t The index of the rod where all disks resides or `HANOI_INCOMPLETE` if the puzzle
+ * is not complete.
+ */
+uint32_t
+hanoi_packed_complete (const struct hanoi_packed *pk)
+{
+  return pk->complete_rod;
+}
+
+/**
+ * @brief Copies the state of a `struct hanoi_puzzle` into a `struct hanoi_packed` of the same size.
+ *
+ * @param pk Target `struct hanoi_packed`.
+ * @param pzl
+ */
+void
+hanoi_packed_from_puzzle (struct hanoi_packed *pk, const struct hanoi_puzzle *pzl)
+{
+  for (uint32_t i = 0; i < pzl->n_rods; ++i)
+    {
+      for (uint32_t j = 0; j < pzl->heights[i]; ++j)
+        {
+          set_rod (pk, pzl->state[i][j], i);
+        }
+
+      pk->heights[i] = pzl->heights[i];
+      pk->tops[i] = hanoi_top_disk (pzl, i);
+    }
+
+  pk->complete_rod = hanoi_complete (pzl);
+}
+
+/**
+ * @brief Copies the state of a `struct hanoi_packed` into a `struct hanoi_puzzle` of the same size.
+ *
+ * @param pk
+ * @param pzl Target `struct hanoi_puzzle`.
+ */
+void
+hanoi_packed_to_puzzle (const struct hanoi_packed *pk, struct hanoi_puzzle *pzl)
+{
+  for (uint32_t i = 0; i < pk->n_rods; ++i)
+    {
+      pzl->heights[i] = 0;
+    }
+
+  for (uint32_t d = pk->n_disks; d > 0; --d)
+    {
+      const uint32_t i = hanoi_packed_rod (pk, d);
+      pzl->state[i][pzl->heights[i]++] = d;
+    }
+
+  for (uint32_t i = 0; i < pk->n_rods; ++i)
+    {
+      for (uint32_t j = pzl->heights[i]; j < pk->n_disks; ++j)
+        {
+          pzl->state[i][j] = 0;
+        }
+    }
+
+  pzl->complete_rod = pk->complete_rod;
+}
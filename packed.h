@@ -0,0 +1,59 @@
+
+#ifndef PACKED_H
+#define PACKED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hanoi.h"
+
+/**
+ * Puzzle stored as the rod of every disk, `bits` bits per disk, with `per_word` disks in each word
+ * of `rods` starting from the smallest disk. `tops` holds the top disk of every rod, or 0 for an
+ * empty rod, and `heights` the amount of disks on it.
+ */
+struct hanoi_packed
+{
+  uint32_t n_rods;
+  uint32_t n_disks;
+  uint32_t bits;
+  uint32_t per_word;
+  uint64_t lows;
+  uint64_t highs;
+  uint64_t *rods;
+  uint32_t *tops;
+  uint32_t *heights;
+  uint32_t complete_rod;
+};
+
+enum hanoi_init_response
+hanoi_packed_init (struct hanoi_packed *pk, const uint32_t n_rods, const uint32_t n_disks);
+
+enum hanoi_init_response
+hanoi_packed_init_copy (struct hanoi_packed *pk, const struct hanoi_packed *src);
+
+void
+hanoi_packed_free (struct hanoi_packed *pk);
+
+bool
+hanoi_packed_move (struct hanoi_packed *pk, const uint32_t src_i, const uint32_t des_i);
+
+bool
+hanoi_packed_empty_rod (const struct hanoi_packed *pk, const uint32_t i);
+
+uint32_t
+hanoi_packed_top_disk (const struct hanoi_packed *pk, const uint32_t i);
+
+uint32_t
+hanoi_packed_complete (const struct hanoi_packed *pk);
+
+uint32_t
+hanoi_packed_rod (const struct hanoi_packed *pk, const uint32_t disk);
+
+void
+hanoi_packed_from_puzzle (struct hanoi_packed *pk, const struct hanoi_puzzle *pzl);
+
+void
+hanoi_packed_to_puzzle (const struct hanoi_packed *pk, struct hanoi_puzzle *pzl);
+
+#endif /* PACKED_H */
\ No newline at end of file
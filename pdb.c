@@ -0,0 +1,654 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bitboard.h"
+#include "explore.h"
+#include "hanoi.h"
+#include "pdb.h"
+#include "solve.h"
+
+#define PDB_MAGIC 0x42445048 /* "HPDB" */
+#define PDB_VERSION 1
+#define PDB_HEADER_SIZE (4 * sizeof (uint32_t))
+
+/* clang-format off */
+
+static uint32_t * header_magic   (uint8_t *header) { return (uint32_t *)&header[0]; }
+static uint32_t * header_version (uint8_t *header) { return (uint32_t *)&header[4]; }
+static uint32_t * header_n_rods  (uint8_t *header) { return (uint32_t *)&header[8]; }
+static uint32_t * header_n_disks (uint8_t *header) { return (uint32_t *)&header[12]; }
+
+/* clang-format on */
+
+struct build
+{
+  uint8_t *distances;
+  bool overflow;
+};
+
+static void
+store_level (const uint32_t distance, const uint64_t *states, const size_t n_states, void *data)
+{
+  struct build *build = data;
+
+  if (distance > UINT8_MAX)
+    {
+      build->overflow = true;
+      return;
+    }
+
+  for (size_t i = 0; i < n_states; ++i)
+    {
+      build->distances[states[i]] = distance;
+    }
+}
+
+/**
+ * @brief Builds a pattern database and writes it to a file. The database holds one byte for each of
+ * the n_rods^n_disks states.
+ *
+ * @param path Where to write the database.
+ * @param n_rods Amount of rods. At least 2 and at most `HANOI_BITBOARD_MAX_RODS`.
+ * @param n_disks Amount of disks in a pattern. n_rods^n_disks may not exceed 2^32.
+ * @return true - The database was written.
+ * @return false - Unsupported size, distances above 255 or system failure. Check `errno`.
+ */
+bool
+hanoi_pdb_build (const char *path, const uint32_t n_rods, const uint32_t n_disks)
+{
+  uint64_t n_states = 1;
+
+  for (uint32_t d = 0; d < n_disks; ++d)
+    {
+      n_states *= n_rods;
+      if (n_states > ((uint64_t)1 << 32))
+        {
+          break;
+        }
+    }
+
+  if (n_rods < 2 || n_rods > HANOI_BITBOARD_MAX_RODS || n_disks == 0
+      || n_states > ((uint64_t)1 << 32))
+    {
+      errno = EINVAL;
+      return false;
+    }
+
+  struct build build = { malloc (n_states), false };
+  if (build.distances == NULL)
+    {
+      return false;
+    }
+
+  struct hanoi_explore_options options = { 0 };
+  struct hanoi_explore_result result;
+
+  options.callback = store_level;
+  options.data = &build;
+
+  /* Every digit set to the last rod. */
+  if (!hanoi_explore (n_rods, n_disks, n_states - 1, &options, &result))
+    {
+      free (build.distances);
+      return false;
+    }
+
+  hanoi_explore_result_free (&result);
+
+  if (build.overflow)
+    {
+      free (build.distances);
+      errno = ERANGE;
+      return false;
+    }
+
+  uint8_t header[PDB_HEADER_SIZE];
+
+  *header_magic (header) = PDB_MAGIC;
+  *header_version (header) = PDB_VERSION;
+  *header_n_rods (header) = n_rods;
+  *header_n_disks (header) = n_disks;
+
+  FILE *file = fopen (path, "wb");
+  if (file == NULL)
+    {
+      free (build.distances);
+      return false;
+    }
+
+  const bool ok = fwrite (header, sizeof (header), 1, file) == 1
+                  && fwrite (build.distances, 1, n_states, file) == n_states;
+
+  free (build.distances);
+
+  return fclose (file) == 0 && ok;
+}
+
+/**
+ * @brief Memory maps a pattern database written by `hanoi_pdb_build`. A successful open must be
+ * closed using `hanoi_pdb_close`.
+ *
+ * @param pdb Target `struct hanoi_pdb`.
+ * @param path
+ * @return true - The database is ready to use.
+ * @return false - Not a pattern database or system failure. Check `errno`.
+ */
+bool
+hanoi_pdb_open (struct hanoi_pdb *pdb, const char *path)
+{
+  const int fd = open (path, O_RDONLY);
+  if (fd == -1)
+    {
+      return false;
+    }
+
+  struct stat st;
+  if (fstat (fd, &st) == -1)
+    {
+      close (fd);
+      return false;
+    }
+
+  if (st.st_size < PDB_HEADER_SIZE)
+    {
+      close (fd);
+      errno = EINVAL;
+      return false;
+    }
+
+  uint8_t *map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+
+  if (map == MAP_FAILED)
+    {
+      return false;
+    }
+
+  const uint32_t n_rods = *header_n_rods (map);
+  const uint32_t n_disks = *header_n_disks (map);
+  uint64_t n_states = 1;
+
+  for (uint32_t d = 0; d < n_disks && n_states <= ((uint64_t)1 << 32); ++d)
+    {
+      n_states *= n_rods;
+    }
+
+  if (*header_magic (map) != PDB_MAGIC || *header_version (map) != PDB_VERSION || n_rods < 2
+      || n_rods > HANOI_BITBOARD_MAX_RODS || n_disks == 0
+      || (uint64_t)st.st_size != PDB_HEADER_SIZE + n_states)
+    {
+      munmap (map, st.st_size);
+      errno = EINVAL;
+      return false;
+    }
+
+  pdb->n_rods = n_rods;
+  pdb->n_disks = n_disks;
+  pdb->distances = map + PDB_HEADER_SIZE;
+  pdb->map = map;
+  pdb->map_len = st.st_size;
+
+  return true;
+}
+
+void
+hanoi_pdb_close (struct hanoi_pdb *pdb)
+{
+  munmap (pdb->map, pdb->map_len);
+}
+
+/**
+ * A* search state. Nodes are identified by their rank, see `hanoi_rank`, and the open list is a
+ * bucket queue indexed by estimated solution length.
+ */
+struct node
+{
+  uint64_t rank;
+  uint32_t parent;
+  uint32_t g;
+  uint8_t src_i;
+  uint8_t des_i;
+  bool closed;
+};
+
+struct bucket
+{
+  uint32_t *nodes;
+  uint32_t len;
+  uint32_t cap;
+};
+
+struct search
+{
+  const struct hanoi_pdb *pdb;
+  uint32_t n_rods;
+  uint32_t n_disks;
+  uint32_t n_targets;
+  uint32_t targets[HANOI_BITBOARD_MAX_RODS];
+  uint64_t powers[HANOI_BITBOARD_MAX_DISKS];
+  struct node *nodes;
+  uint32_t n_nodes;
+  uint32_t cap_nodes;
+  uint32_t *slots;
+  uint64_t n_slots;
+  struct bucket *buckets;
+  uint32_t n_buckets;
+};
+
+static uint32_t
+relabel (const struct search *search, const uint32_t t, const uint32_t i)
+{
+  const uint32_t last = search->n_rods - 1;
+  const uint32_t target = search->targets[t];
+
+  return i == target ? last : i == last ? target : i;
+}
+
+/**
+ * Ranks in the pattern database of every group of disks, for every target rod.
+ */
+struct estimate
+{
+  uint32_t ranks[HANOI_BITBOARD_MAX_RODS][HANOI_BITBOARD_MAX_DISKS];
+  uint32_t h[HANOI_BITBOARD_MAX_RODS];
+};
+
+static uint32_t
+group_lo (const struct search *search, const uint32_t g)
+{
+  const uint32_t k = search->pdb->n_disks;
+  return search->n_disks > (g + 1) * k ? search->n_disks - (g + 1) * k : 0;
+}
+
+/**
+ * Sum of the pattern database distances of the groups of `pdb->n_disks` disks, starting from the
+ * largest disk. Missing disks of the group of smallest disks are placed below the others on the
+ * target rod, where they never get in the way.
+ */
+static uint32_t
+estimate (const struct search *search, const uint32_t *rods, struct estimate *e)
+{
+  const struct hanoi_pdb *pdb = search->pdb;
+  const uint32_t k = pdb->n_disks;
+  uint32_t best = UINT32_MAX;
+
+  for (uint32_t t = 0; t < search->n_targets; ++t)
+    {
+      e->h[t] = 0;
+
+      for (uint32_t g = 0; g * k < search->n_disks; ++g)
+        {
+          const uint32_t hi = search->n_disks - g * k;
+          const uint32_t lo = group_lo (search, g);
+          uint32_t rank = 0;
+
+          for (uint32_t j = k; j > hi - lo; --j)
+            {
+              rank = rank * search->n_rods + search->n_rods - 1;
+            }
+
+          for (uint32_t d = hi; d > lo; --d)
+            {
+              rank = rank * search->n_rods + relabel (search, t, rods[d - 1]);
+            }
+
+          e->ranks[t][g] = rank;
+          e->h[t] += pdb->distances[rank];
+        }
+
+      best = e->h[t] < best ? e->h[t] : best;
+    }
+
+  return best;
+}
+
+/**
+ * The estimate after moving disk `d`, from the estimate before the move.
+ */
+static uint32_t
+estimate_move (const struct search *search, const struct estimate *e, const uint32_t d,
+               const uint32_t src_i, const uint32_t des_i)
+{
+  const uint8_t *distances = search->pdb->distances;
+  const uint32_t g = (search->n_disks - 1 - d) / search->pdb->n_disks;
+  const uint32_t p = search->powers[d - group_lo (search, g)];
+  uint32_t best = UINT32_MAX;
+
+  for (uint32_t t = 0; t < search->n_targets; ++t)
+    {
+      const uint32_t rank = e->ranks[t][g];
+      const uint32_t next = rank + (relabel (search, t, des_i) - relabel (search, t, src_i)) * p;
+      const uint32_t h = e->h[t] - distances[rank] + distances[next];
+
+      best = h < best ? h : best;
+    }
+
+  return best;
+}
+
+static void
+unrank (const struct search *search, uint64_t rank, uint32_t *rods)
+{
+  for (uint32_t d = 0; d < search->n_disks; ++d)
+    {
+      rods[d] = rank % search->n_rods;
+      rank /= search->n_rods;
+    }
+}
+
+static bool
+search_init (struct search *search, const struct hanoi_pdb *pdb, const struct hanoi_puzzle *pzl,
+             const uint32_t des_i, uint64_t *rank)
+{
+  if (pdb->n_rods != pzl->n_rods || pzl->n_disks > HANOI_BITBOARD_MAX_DISKS
+      || (des_i != HANOI_INCOMPLETE && des_i >= pzl->n_rods) || !hanoi_rank (pzl, rank))
+    {
+      errno = EINVAL;
+      return false;
+    }
+
+  search->pdb = pdb;
+  search->n_rods = pzl->n_rods;
+  search->n_disks = pzl->n_disks;
+  search->n_targets = des_i == HANOI_INCOMPLETE ? pzl->n_rods : 1;
+
+  for (uint32_t t = 0; t < search->n_targets; ++t)
+    {
+      search->targets[t] = des_i == HANOI_INCOMPLETE ? t : des_i;
+    }
+
+  for (uint64_t d = 0, p = 1; d < pzl->n_disks; ++d, p *= pzl->n_rods)
+    {
+      search->powers[d] = p;
+    }
+
+  search->nodes = NULL;
+  search->n_nodes = 0;
+  search->cap_nodes = 0;
+  search->slots = NULL;
+  search->n_slots = 0;
+  search->buckets = NULL;
+  search->n_buckets = 0;
+
+  return true;
+}
+
+static void
+search_free (struct search *search)
+{
+  for (uint32_t f = 0; f < search->n_buckets; ++f)
+    {
+      free (search->buckets[f].nodes);
+    }
+
+  free (search->buckets);
+  free (search->slots);
+  free (search->nodes);
+}
+
+static uint64_t
+slot (const struct search *search, const uint64_t rank)
+{
+  return (rank * 0x9e3779b97f4a7c15) >> 17 & (search->n_slots - 1);
+}
+
+/**
+ * Finds the node of a rank or the empty slot where it belongs. Slots hold node indices plus one.
+ */
+static uint32_t *
+find (const struct search *search, const uint64_t rank)
+{
+  uint64_t i = slot (search, rank);
+
+  while (search->slots[i] != 0 && search->nodes[search->slots[i] - 1].rank != rank)
+    {
+      i = (i + 1) & (search->n_slots - 1);
+    }
+
+  return &search->slots[i];
+}
+
+static bool
+grow_slots (struct search *search)
+{
+  const uint64_t n_slots = search->n_slots == 0 ? 1 << 12 : search->n_slots * 2;
+  uint32_t *slots = calloc (n_slots, sizeof (slots[0]));
+
+  if (slots == NULL)
+    {
+      return false;
+    }
+
+  free (search->slots);
+  search->slots = slots;
+  search->n_slots = n_slots;
+
+  for (uint32_t i = 0; i < search->n_nodes; ++i)
+    {
+      *find (search, search->nodes[i].rank) = i + 1;
+    }
+
+  return true;
+}
+
+static bool
+push (struct search *search, const uint32_t f, const uint32_t i)
+{
+  struct bucket *bucket = &search->buckets[f];
+
+  if (bucket->len == bucket->cap)
+    {
+      const uint32_t cap = bucket->cap == 0 ? 64 : bucket->cap * 2;
+      uint32_t *nodes = realloc (bucket->nodes, sizeof (nodes[0]) * cap);
+
+      if (nodes == NULL)
+        {
+          return false;
+        }
+
+      bucket->nodes = nodes;
+      bucket->cap = cap;
+    }
+
+  bucket->nodes[bucket->len++] = i;
+  return true;
+}
+
+/**
+ * Adds a node reached with `g` moves, or shortens the path to it if it is known.
+ */
+static bool
+visit (struct search *search, const uint64_t rank, const uint32_t g, const uint32_t parent,
+       const uint32_t src_i, const uint32_t des_i, const uint32_t h)
+{
+  if (g + h >= search->n_buckets)
+    {
+      return true;
+    }
+
+  if (2 * ((uint64_t)search->n_nodes + 1) > search->n_slots && !grow_slots (search))
+    {
+      return false;
+    }
+
+  uint32_t *s = find (search, rank);
+
+  if (*s == 0)
+    {
+      if (search->n_nodes == search->cap_nodes)
+        {
+          const uint32_t cap = search->cap_nodes == 0 ? 1 << 12 : search->cap_nodes * 2;
+          struct node *nodes = realloc (search->nodes, sizeof (nodes[0]) * cap);
+
+          if (nodes == NULL)
+            {
+              return false;
+            }
+
+          search->nodes = nodes;
+          search->cap_nodes = cap;
+        }
+
+      *s = ++search->n_nodes;
+    }
+  else if (search->nodes[*s - 1].g <= g)
+    {
+      return true;
+    }
+
+  search->nodes[*s - 1] = (struct node){ rank, parent, g, src_i, des_i, false };
+  return push (search, g + h, *s - 1);
+}
+
+/**
+ * @brief Lower bound of the amount of moves left to complete a puzzle, as the sum of the pattern
+ * database distances of its groups of disks.
+ *
+ * @param pdb
+ * @param pzl
+ * @param des_i Rod to complete the puzzle on or `HANOI_INCOMPLETE` for any rod.
+ * @return uint32_t The lower bound or `HANOI_INCOMPLETE` if the puzzle is not supported by `pdb`.
+ */
+uint32_t
+hanoi_pdb_heuristic (const struct hanoi_pdb *pdb, const struct hanoi_puzzle *pzl,
+                     const uint32_t des_i)
+{
+  struct search search;
+  uint64_t rank;
+
+  if (!search_init (&search, pdb, pzl, des_i, &rank))
+    {
+      return HANOI_INCOMPLETE;
+    }
+
+  uint32_t rods[HANOI_BITBOARD_MAX_DISKS];
+  struct estimate e;
+
+  unrank (&search, rank, rods);
+
+  return estimate (&search, rods, &e);
+}
+
+/**
+ * @brief Finds an optimal solution from any legal state with A*, using the sum of the pattern
+ * database distances of disjoint groups of disks as heuristic. The heuristic is consistent, so
+ * every state is expanded at most once.
+ *
+ * @param pdb A pattern database with as many rods as `pzl`.
+ * @param pzl The state to start from. n_rods^n_disks must fit in 64 bits.
+ * @param des_i Rod to complete the puzzle on or `HANOI_INCOMPLETE` for the nearest rod.
+ * @param moves Receives the moves of the solution.
+ * @param max_moves Length of `moves`.
+ * @param n_moves Receives the amount of moves in the solution.
+ * @return true - `moves` holds an optimal solution.
+ * @return false - Unsupported puzzle, system failure or the solution is longer than `max_moves`.
+ * Check `errno`.
+ */
+bool
+hanoi_pdb_solve (const struct hanoi_pdb *pdb, const struct hanoi_puzzle *pzl, const uint32_t des_i,
+                 struct hanoi_move *moves, const uint32_t max_moves, uint32_t *n_moves)
+{
+  struct search search;
+  uint64_t rank;
+
+  if (!search_init (&search, pdb, pzl, des_i, &rank))
+    {
+      return false;
+    }
+
+  uint32_t rods[HANOI_BITBOARD_MAX_DISKS];
+  uint32_t tops[HANOI_BITBOARD_MAX_RODS];
+  struct estimate e;
+
+  unrank (&search, rank, rods);
+
+  search.n_buckets = max_moves + 1;
+  search.buckets = calloc (search.n_buckets, sizeof (search.buckets[0]));
+
+  if (search.buckets == NULL || !visit (&search, rank, 0, 0, 0, 0, estimate (&search, rods, &e)))
+    {
+      search_free (&search);
+      return false;
+    }
+
+  for (uint32_t f = 0; f < search.n_buckets; ++f)
+    {
+      struct bucket *bucket = &search.buckets[f];
+
+      while (bucket->len > 0)
+        {
+          const uint32_t i = bucket->nodes[--bucket->len];
+          struct node node = search.nodes[i];
+
+          /* Nodes reached again with fewer moves are pushed again, with a lower estimate. */
+          if (node.closed)
+            {
+              continue;
+            }
+
+          search.nodes[i].closed = true;
+          unrank (&search, node.rank, rods);
+          estimate (&search, rods, &e);
+
+          if (node.g == f)
+            {
+              /* The heuristic is 0, so every disk is on a target rod. */
+              *n_moves = node.g;
+              for (uint32_t j = node.g, k = i; j > 0; --j, k = search.nodes[k].parent)
+                {
+                  moves[j - 1].src_i = search.nodes[k].src_i;
+                  moves[j - 1].des_i = search.nodes[k].des_i;
+                }
+              search_free (&search);
+              return true;
+            }
+
+          for (uint32_t r = 0; r < search.n_rods; ++r)
+            {
+              tops[r] = UINT32_MAX;
+            }
+          for (uint32_t d = search.n_disks; d > 0; --d)
+            {
+              tops[rods[d - 1]] = d - 1;
+            }
+
+          for (uint32_t src_i = 0; src_i < search.n_rods; ++src_i)
+            {
+              const uint32_t d = tops[src_i];
+
+              if (d == UINT32_MAX)
+                {
+                  continue;
+                }
+
+              for (uint32_t des_i = 0; des_i < search.n_rods; ++des_i)
+                {
+                  if (des_i == src_i || tops[des_i] < d)
+                    {
+                      continue;
+                    }
+
+                  const uint64_t next = node.rank + (des_i - (uint64_t)src_i) * search.powers[d];
+
+                  if (!visit (&search, next, node.g + 1, i, src_i, des_i,
+                              estimate_move (&search, &e, d, src_i, des_i)))
+                    {
+                      search_free (&search);
+                      return false;
+                    }
+                }
+            }
+        }
+    }
+
+  search_free (&search);
+  errno = ERANGE;
+  return false;
+}
@@ -0,0 +1,42 @@
+
+#ifndef PDB_H
+#define PDB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hanoi.h"
+#include "solve.h"
+
+/**
+ * Pattern database of a puzzle with `n_disks` disks. `distances[rank]` is the least amount of moves
+ * to bring every disk of the state with that rank, see `hanoi_rank`, to the last rod.
+ */
+struct hanoi_pdb
+{
+  uint32_t n_rods;
+  uint32_t n_disks;
+  const uint8_t *distances;
+  void *map;
+  size_t map_len;
+};
+
+bool
+hanoi_pdb_build (const char *path, const uint32_t n_rods, const uint32_t n_disks);
+
+bool
+hanoi_pdb_open (struct hanoi_pdb *pdb, const char *path);
+
+void
+hanoi_pdb_close (struct hanoi_pdb *pdb);
+
+uint32_t
+hanoi_pdb_heuristic (const struct hanoi_pdb *pdb, const struct hanoi_puzzle *pzl,
+                     const uint32_t des_i);
+
+bool
+hanoi_pdb_solve (const struct hanoi_pdb *pdb, const struct hanoi_puzzle *pzl, const uint32_t des_i,
+                 struct hanoi_move *moves, const uint32_t max_moves, uint32_t *n_moves);
+
+#endif /* PDB_H */
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "hanoi.h"
+#include "pool.h"
+
+/**
+ * @brief Initializes a `struct hanoi_pool` with room for `n_slots` puzzles. The arena is a single
+ * cache line aligned allocation. A succsessfull init must be freed using `hanoi_pool_free`.
+ *
+ * @param pool Target `struct hanoi_pool`.
+ * @param n_rods Amount of rods in every puzzle.
+ * @param n_disks Amount of disks in every puzzle.
+ * @param n_slots Amount of puzzles the pool can hold at once.
+ * @return HANOI_INIT_OK - Init successful.
+ * @return HANOI_INIT_INVALID_N_RODS_VALUE - The value of `n_rods` was set to `HANOI_INCOMPLATE`.
+ * @return HANOI_INIT_SYSTEM_ERROR - System failure during init. Check `errno`.
+ */
+enum hanoi_init_response
+hanoi_pool_init (struct hanoi_pool *pool, const uint32_t n_rods, const uint32_t n_disks,
+                 const size_t n_slots)
+{
+  if (n_rods == HANOI_INCOMPLETE)
+    {
+      return HANOI_INIT_INVALID_N_RODS_VALUE;
+    }
+
+  const size_t storage_size = hanoi_storage_size (n_rods, n_disks);
+  size_t slot_size;
+  size_t arena_size;
+
+  if (storage_size == SIZE_MAX
+      || __builtin_add_overflow (storage_size,
+                                 sizeof (struct hanoi_puzzle) + HANOI_POOL_ALIGNMENT - 1,
+                                 &slot_size)
+      || __builtin_mul_overflow (slot_size & ~(size_t)(HANOI_POOL_ALIGNMENT - 1),
+                                 n_slots > 0 ? n_slots : 1, &arena_size))
+    {
+      errno = ENOMEM;
+      return HANOI_INIT_SYSTEM_ERROR;
+    }
+  slot_size &= ~(size_t)(HANOI_POOL_ALIGNMENT - 1);
+
+  pool->arena = aligned_alloc (HANOI_POOL_ALIGNMENT, arena_size);
+  if (pool->arena == NULL)
+    {
+      return HANOI_INIT_SYSTEM_ERROR;
+    }
+
+  pool->n_rods = n_rods;
+  pool->n_disks = n_disks;
+  pool->slot_size = slot_size;
+  pool->n_slots = n_slots;
+  pool->free_list = NULL;
+
+  /* Push in reverse so the first acquires walk the arena front to back. */
+  for (size_t i = n_slots; i > 0; --i)
+    {
+      void **slot = (void **)(pool->arena + (i - 1) * slot_size);
+      *slot = pool->free_list;
+      pool->free_list = slot;
+    }
+
+  return HANOI_INIT_OK;
+}
+
+void
+hanoi_pool_free (struct hanoi_pool *pool)
+{
+  free (pool->arena);
+}
+
+/**
+ * @brief Takes a puzzle from the pool, reset to the start position.
+ *
+ * @param pool The pool.
+ * @return struct hanoi_puzzle* - The puzzle, or `NULL` if every slot is in use.
+ */
+struct hanoi_puzzle *
+hanoi_pool_acquire (struct hanoi_pool *pool)
+{
+  void **slot = pool->free_list;
+  if (slot == NULL)
+    {
+      return NULL;
+    }
+  pool->free_list = *slot;
+
+  struct hanoi_puzzle *pzl = (struct hanoi_puzzle *)slot;
+  hanoi_init_in (pzl, pzl + 1, pool->n_rods, pool->n_disks);
+
+  return pzl;
+}
+
+/**
+ * @brief Gives a puzzle back to the pool it was acquired from. The puzzle must not be used after.
+ *
+ * @param pool The pool.
+ * @param pzl Puzzle returned by `hanoi_pool_acquire` on `pool`.
+ */
+void
+hanoi_pool_release (struct hanoi_pool *pool, struct hanoi_puzzle *pzl)
+{
+  void **slot = (void **)pzl;
+  *slot = pool->free_list;
+  pool->free_list = slot;
+}
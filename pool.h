@@ -0,0 +1,40 @@
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hanoi.h"
+
+#define HANOI_POOL_ALIGNMENT 64
+
+/**
+ * Arena of same sized puzzles. Every slot is a `struct hanoi_puzzle` followed by its storage, see
+ * `hanoi_init_in`, padded to a whole number of cache lines. Free slots form an intrusive list so
+ * acquire and release are O(1). A pool is not thread safe; use one per thread.
+ */
+struct hanoi_pool
+{
+  uint32_t n_rods;
+  uint32_t n_disks;
+  size_t slot_size;
+  size_t n_slots;
+  unsigned char *arena;
+  void *free_list;
+};
+
+enum hanoi_init_response
+hanoi_pool_init (struct hanoi_pool *pool, const uint32_t n_rods, const uint32_t n_disks,
+                 const size_t n_slots);
+
+void
+hanoi_pool_free (struct hanoi_pool *pool);
+
+struct hanoi_puzzle *
+hanoi_pool_acquire (struct hanoi_pool *pool);
+
+void
+hanoi_pool_release (struct hanoi_pool *pool, struct hanoi_puzzle *pzl);
+
+#endif /* POOL_H */
\ No newline at end of file
@@ -1,24 +1,57 @@
+#include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "hanoi.h"
+#include "leaderboard.h"
+#include "packed.h"
 #include "record.h"
+#include "stats.h"
 
 #define FILENAME_LEN 12
-#define MAX_USERNAME_LEN 32
+#define MAX_USERNAME_LEN HANOI_RECORD_MAX_USERNAME_LEN
+#define MOVE_SIZE (sizeof (uint32_t) * 4)
+#define MAX_ENCODED_MOVE 20
 
+/* A keyframe is the move it is taken before, the offset of that move in the log and the duration
+   of the move before it, followed by the compact snapshot padded to a word. The index ends with a
+   footer of the interval, the amount of keyframes, the size of one and `KEYFRAME_MAGIC`. */
+#define KEYFRAME_HEAD_SIZE (sizeof (uint64_t) * 3)
+#define FOOTER_SIZE (sizeof (uint64_t) * 4)
+#define KEYFRAME_MAGIC 0x5359454b494f4e48 /* "HNOIKEYS" */
+#define DEFAULT_RING_SIZE 4096
+#define DEFAULT_SEGMENT_SIZE ((uint64_t)64 << 20)
+#define MAX_PATH_ATTEMPTS 64
+#define RECORD_MODE (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)
+
+#define PREFIX_SIZE (sizeof (uint32_t) + sizeof (uint16_t) + sizeof (uint16_t))
 #define HEADER_SIZE                                                                                \
   (sizeof (uint64_t) + sizeof (uint64_t) + sizeof (uint32_t) + sizeof (uint32_t)                   \
    + sizeof (uint64_t) + MAX_USERNAME_LEN)
 
+#define CHECKSUM_SEED 142573
+
 /* clang-format off */
 
+static uint32_t * prefix_magic   (uint8_t *prefix) { return (uint32_t *)&prefix[0]; }
+static uint16_t * prefix_version (uint8_t *prefix) { return (uint16_t *)&prefix[4]; }
+static uint16_t * prefix_flags   (uint8_t *prefix) { return (uint16_t *)&prefix[6]; }
+
+static const uint32_t * prefix_const_magic   (const uint8_t *prefix) { return (const uint32_t *)&prefix[0]; }
+static const uint16_t * prefix_const_version (const uint8_t *prefix) { return (const uint16_t *)&prefix[4]; }
+static const uint16_t * prefix_const_flags   (const uint8_t *prefix) { return (const uint16_t *)&prefix[6]; }
+
 static uint64_t * header_checksum (uint8_t *header) { return (uint64_t *)&header[0]; }
 static uint64_t * header_moves    (uint8_t *header) { return (uint64_t *)&header[8]; }
 static uint32_t * header_n_rods   (uint8_t *header) { return (uint32_t *)&header[16]; }
@@ -27,13 +60,13 @@ static uint64_t * header_date     (uint8_t *header) { return (uint64_t *)&header
 static char     * header_username (uint8_t *header) { return (char *)&header[32]; }
 // static uint32_t * header_puzzle   (uint8_t *header) { return (uint32_t *)&header[64]; }
 
-// static const uint64_t * header_const_checksum (const uint8_t *header) { return (const uint64_t *)&header[0]; }
+static const uint64_t * header_const_checksum (const uint8_t *header) { return (const uint64_t *)&header[0]; }
 static const uint64_t * header_const_moves    (const uint8_t *header) { return (const uint64_t *)&header[8]; }
 static const uint32_t * header_const_n_rods   (const uint8_t *header) { return (const uint32_t *)&header[16]; }
 static const uint32_t * header_const_n_disks  (const uint8_t *header) { return (const uint32_t *)&header[20]; }
-// static const uint64_t * header_const_date     (const uint8_t *header) { return (const uint64_t *)&header[24]; }
-// static const char     * header_const_username (const uint8_t *header) { return (const char *)&header[32]; }
-// static const uint32_t * header_const_puzzle   (const uint8_t *header) { return (const uint32_t *)&header[64]; }
+static const uint64_t * header_const_date     (const uint8_t *header) { return (const uint64_t *)&header[24]; }
+static const char     * header_const_username (const uint8_t *header) { return (const char *)&header[32]; }
+static const uint32_t * header_const_puzzle   (const uint8_t *header) { return (const uint32_t *)&header[64]; }
 
 /* clang-format on */
 
@@ -43,11 +76,16 @@ static const char alphabet[]
 
 static size_t recorder_path_filename_offset;
 static char *recorder_path = NULL;
+static uint16_t record_version = HANOI_RECORD_VERSION;
+static uint32_t record_keyframe_interval = 0;
+static enum hanoi_record_storage record_storage = HANOI_RECORD_STORAGE_FILES;
+static uint64_t record_segment_size = DEFAULT_SEGMENT_SIZE;
+static uint32_t record_segment = 0;
 
 static char *
 generate_recorder_path ()
 {
-  char *path = malloc (strlen (recorder_path));
+  char *path = malloc (strlen (recorder_path) + 1);
   strcpy (path, recorder_path);
 
   for (int i = recorder_path_filename_offset; i < recorder_path_filename_offset + FILENAME_LEN; ++i)
@@ -65,7 +103,7 @@ generate_recorder_path ()
  * @return uint64_t Hash
  */
 uint64_t
-djb2 (uint64_t hash, uint8_t *data, size_t len)
+djb2 (uint64_t hash, const uint8_t *data, size_t len)
 {
   while (len--)
     {
@@ -75,6 +113,231 @@ djb2 (uint64_t hash, uint8_t *data, size_t len)
   return hash;
 }
 
+static uint64_t
+mix (uint64_t hash, const uint64_t word)
+{
+  hash ^= word * 0x9e3779b97f4a7c15;
+  hash = hash << 31 | hash >> 33;
+  return hash * 0xbf58476d1ce4e5b9;
+}
+
+/**
+ * @brief Checksum of records from `HANOI_RECORD_VERSION` on. Each piece of the record is hashed a
+ * word at a time as it is written, with a short last word padded with zeros, so the checksum is
+ * known the moment the record is finished. See `hash_finish`.
+ *
+ * @param hash Hash of the pieces before.
+ * @param data
+ * @param len
+ * @return uint64_t Hash
+ */
+static uint64_t
+hash_words (uint64_t hash, const void *data, size_t len)
+{
+  const uint8_t *bytes = data;
+  uint64_t word;
+
+  for (; len >= sizeof (word); bytes += sizeof (word), len -= sizeof (word))
+    {
+      memcpy (&word, bytes, sizeof (word));
+      hash = mix (hash, word);
+    }
+
+  if (len > 0)
+    {
+      word = 0;
+      memcpy (&word, bytes, len);
+      hash = mix (hash, word);
+    }
+
+  return hash;
+}
+
+/**
+ * @brief Mixes in the move count, which changes with every move and is therefore left out of the
+ * running hash, and spreads the bits of the result.
+ */
+static uint64_t
+hash_finish (uint64_t hash, const uint64_t moves)
+{
+  hash = mix (hash, moves);
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccd;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+/**
+ * @brief Amount of bits used for the rod of a disk in a compact snapshot.
+ */
+static uint32_t
+rod_bits (const uint32_t n_rods)
+{
+  uint32_t bits = 1;
+
+  while (bits < 32 && ((uint64_t)1 << bits) < n_rods)
+    {
+      ++bits;
+    }
+
+  return bits;
+}
+
+static size_t
+compact_snapshot_size (const uint32_t n_rods, const uint32_t n_disks)
+{
+  return ((size_t)n_disks * rod_bits (n_rods) + 7) / 8;
+}
+
+static void
+compact_set_rod (uint8_t *snapshot, const uint32_t bits, const uint32_t disk, const uint32_t rod)
+{
+  const size_t p = (size_t)(disk - 1) * bits;
+
+  for (uint32_t k = 0; k < bits; ++k)
+    {
+      snapshot[(p + k) / 8] |= ((rod >> k) & 1) << ((p + k) % 8);
+    }
+}
+
+static uint32_t
+compact_get_rod (const uint8_t *snapshot, const uint32_t bits, const uint32_t disk)
+{
+  const size_t p = (size_t)(disk - 1) * bits;
+  uint32_t rod = 0;
+
+  for (uint32_t k = 0; k < bits; ++k)
+    {
+      rod |= (uint32_t)((snapshot[(p + k) / 8] >> ((p + k) % 8)) & 1) << k;
+    }
+
+  return rod;
+}
+
+static size_t
+keyframe_size (const uint32_t n_rods, const uint32_t n_disks)
+{
+  return KEYFRAME_HEAD_SIZE + (compact_snapshot_size (n_rods, n_disks) + 7) / 8 * 8;
+}
+
+static size_t
+put_varint (uint8_t *out, uint64_t value)
+{
+  size_t len = 0;
+
+  for (; value >= 0x80; value >>= 7)
+    {
+      out[len++] = (uint8_t)value | 0x80;
+    }
+  out[len++] = (uint8_t)value;
+
+  return len;
+}
+
+static bool
+get_varint (const uint8_t **next, const uint8_t *end, uint64_t *value)
+{
+  *value = 0;
+
+  for (uint32_t shift = 0; *next < end && shift < 64; shift += 7)
+    {
+      const uint8_t byte = *(*next)++;
+      *value |= (uint64_t)(byte & 0x7f) << shift;
+
+      if ((byte & 0x80) == 0)
+        {
+          return true;
+        }
+    }
+
+  return false;
+}
+
+/**
+ * @brief Writes a move the compact way: both rods in one byte when they fit in a nibble, otherwise
+ * as two varints, followed by the change in duration since the last move as a zigzag varint.
+ *
+ * @param out At least `MAX_ENCODED_MOVE` bytes.
+ * @param move Move as it is hashed, `{ src_i, des_i, duration low, duration high }`.
+ * @param duration Duration of the move before, updated to the one of `move`.
+ * @param nibbles The puzzle has at most 16 rods.
+ * @return size_t Amount of bytes written.
+ */
+static size_t
+encode_move (uint8_t *out, const uint32_t *move, uint64_t *duration, const bool nibbles)
+{
+  size_t len = 0;
+  uint64_t current;
+
+  memcpy (&current, &move[2], sizeof (current));
+
+  if (nibbles)
+    {
+      out[len++] = (uint8_t)(move[0] << 4 | move[1]);
+    }
+  else
+    {
+      len += put_varint (out + len, move[0]);
+      len += put_varint (out + len, move[1]);
+    }
+
+  const uint64_t delta = current - *duration;
+  len += put_varint (out + len, delta << 1 ^ -(delta >> 63));
+  *duration = current;
+
+  return len;
+}
+
+/**
+ * @brief Chooses the format of the records made from now on. Legacy records can not be written.
+ *
+ * @param version `HANOI_RECORD_VERSION_FIXED` or `HANOI_RECORD_VERSION_COMPACT`, the default.
+ * @return true - The version was set.
+ * @return false - Unknown version. `errno` is set to `EINVAL`.
+ */
+bool
+hanoi_set_record_version (const uint16_t version)
+{
+  if (version == HANOI_RECORD_VERSION_LEGACY || version > HANOI_RECORD_VERSION)
+    {
+      errno = EINVAL;
+      return false;
+    }
+
+  record_version = version;
+
+  return true;
+}
+
+/**
+ * @brief Makes the records from now on keep a snapshot every `interval` moves, so a reader can
+ * start from the closest one instead of the beginning, see `hanoi_record_seek`. The keyframes are
+ * kept in memory and written after the move log by `hanoi_recorder_write_checksum`.
+ *
+ * @param interval Moves between keyframes, 0 for none, the default.
+ */
+void
+hanoi_set_record_keyframes (const uint32_t interval)
+{
+  record_keyframe_interval = interval;
+}
+
+/**
+ * @brief Chooses where the records from now on are kept. With segments, games are appended to
+ * numbered `.hanoi-segment` files in the records directory, each with a `.hanoi-index` of its
+ * games. A recorder holds a lock on its segment while the game is played, so other recorders move
+ * on to the next one, and a new segment is started once one reaches `segment_size`.
+ *
+ * @param storage
+ * @param segment_size Size in bytes after which a segment is full, 0 for the default of 64 MB.
+ */
+void
+hanoi_set_record_storage (const enum hanoi_record_storage storage, const uint64_t segment_size)
+{
+  record_storage = storage;
+  record_segment_size = segment_size > 0 ? segment_size : DEFAULT_SEGMENT_SIZE;
+}
+
 void
 hanoi_set_records_directory (const char *path)
 {
@@ -87,12 +350,12 @@ hanoi_set_records_directory (const char *path)
 
   if (path[len - 1] == '/')
     {
-      recorder_path = malloc (len + FILENAME_LEN + strlen (".hanoi-puzzle"));
+      recorder_path = malloc (len + FILENAME_LEN + strlen (".hanoi-puzzle") + 1);
       strcpy (recorder_path, path);
     }
   else
     {
-      recorder_path = malloc (len + 1 + FILENAME_LEN + strlen (".hanoi-puzzle"));
+      recorder_path = malloc (len + 1 + FILENAME_LEN + strlen (".hanoi-puzzle") + 1);
       strcpy (recorder_path, path);
       recorder_path[len++] = '/';
     }
@@ -108,125 +371,1628 @@ hanoi_set_records_directory (const char *path)
   recorder_path_filename_offset = len;
 }
 
-bool
-hanoi_new_recorder (struct hanoi_recorder *recorder, const struct hanoi_puzzle *pzl,
-                    const char *username)
+/**
+ * @brief Opens a new file for a single record. The name is random, so a name that is taken is
+ * retried instead of overwriting the game in it.
+ */
+static bool
+open_file (struct hanoi_recorder *recorder)
 {
-  recorder->path = generate_recorder_path ();
+  for (uint32_t attempt = 0; attempt < MAX_PATH_ATTEMPTS; ++attempt)
+    {
+      recorder->path = generate_recorder_path ();
+      recorder->fd = open (recorder->path, O_RDWR | O_CREAT | O_EXCL, RECORD_MODE);
 
-  const int fd
-      = open (recorder->path, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+      if (recorder->fd != -1)
+        {
+          recorder->base = 0;
+          recorder->index_fd = -1;
+          return true;
+        }
 
-  if (fd == -1)
-    {
       free (recorder->path);
+
+      if (errno != EEXIST)
+        {
+          return false;
+        }
+    }
+
+  return false;
+}
+
+static char *
+segment_path (const uint32_t segment, const char *extension)
+{
+  const size_t len = recorder_path_filename_offset + 10 + strlen (extension) + 1;
+  char *path = malloc (len);
+
+  if (path != NULL)
+    {
+      snprintf (path, len, "%.*s%06u%s", (int)recorder_path_filename_offset, recorder_path, segment,
+                extension);
+    }
+
+  return path;
+}
+
+/**
+ * @brief Claims the first segment from `record_segment` on that is neither full nor locked by
+ * another recorder. Anything after the last game in its index is left from a recorder that never
+ * finished and is cut off.
+ */
+static bool
+open_segment (struct hanoi_recorder *recorder)
+{
+  for (uint32_t segment = record_segment; segment < UINT32_MAX; ++segment)
+    {
+      recorder->path = segment_path (segment, ".hanoi-segment");
+      if (recorder->path == NULL)
+        {
+          return false;
+        }
+
+      recorder->fd = open (recorder->path, O_RDWR | O_CREAT, RECORD_MODE);
+      if (recorder->fd == -1)
+        {
+          free (recorder->path);
+          return false;
+        }
+
+      if (flock (recorder->fd, LOCK_EX | LOCK_NB) == -1)
+        {
+          const int error = errno;
+          close (recorder->fd);
+          free (recorder->path);
+
+          if (error == EWOULDBLOCK)
+            {
+              continue;
+            }
+          errno = error;
+          return false;
+        }
+
+      char *index_path = segment_path (segment, ".hanoi-index");
+      recorder->index_fd
+          = index_path != NULL ? open (index_path, O_RDWR | O_CREAT | O_APPEND, RECORD_MODE) : -1;
+      free (index_path);
+
+      struct stat st;
+      struct hanoi_segment_entry last = { 0 };
+      off_t n_entries = 0;
+
+      if (recorder->index_fd == -1 || fstat (recorder->index_fd, &st) == -1)
+        {
+          goto fail;
+        }
+
+      n_entries = st.st_size / sizeof (last);
+
+      /* A partly written entry is from a recorder that stopped while adding it. */
+      if (ftruncate (recorder->index_fd, n_entries * sizeof (last)) == -1
+          || (n_entries > 0
+              && pread (recorder->index_fd, &last, sizeof (last), (n_entries - 1) * sizeof (last))
+                     != sizeof (last)))
+        {
+          goto fail;
+        }
+
+      if (last.offset + last.size >= record_segment_size)
+        {
+          close (recorder->index_fd);
+          close (recorder->fd);
+          free (recorder->path);
+          continue;
+        }
+
+      /* Records are 8 byte aligned so a mapped segment can be read in place. */
+      recorder->base = (last.offset + last.size + 7) / 8 * 8;
+
+      if (ftruncate (recorder->fd, recorder->base) == -1
+          || lseek (recorder->fd, recorder->base, SEEK_SET) == -1)
+        {
+          goto fail;
+        }
+
+      recorder->id = (uint64_t)segment << 32 | n_entries;
+      record_segment = segment;
+      return true;
+
+    fail:
+      {
+        const int error = errno;
+        if (recorder->index_fd != -1)
+          {
+            close (recorder->index_fd);
+          }
+        close (recorder->fd);
+        free (recorder->path);
+        errno = error;
+        return false;
+      }
+    }
+
+  errno = ENOSPC;
+  return false;
+}
+
+static void
+close_storage (struct hanoi_recorder *recorder)
+{
+  if (recorder->index_fd != -1)
+    {
+      close (recorder->index_fd);
+    }
+  close (recorder->fd);
+  free (recorder->path);
+}
+
+static bool
+open_recorder (struct hanoi_recorder *recorder, const uint32_t n_rods, const uint32_t n_disks,
+               const char *username)
+{
+  if (!(record_storage == HANOI_RECORD_STORAGE_SEGMENTS ? open_segment (recorder)
+                                                         : open_file (recorder)))
+    {
       return false;
     }
 
-  recorder->fd = fd;
+  recorder->indexed = false;
+  recorder->leaderboard_error = 0;
+  recorder->date = time (NULL);
+  strncpy (recorder->username, username, MAX_USERNAME_LEN);
   recorder->moves = 0;
+  recorder->version = record_version;
+  recorder->n_rods = n_rods;
+  recorder->n_disks = n_disks;
+  recorder->duration = 0;
+  recorder->log_start = PREFIX_SIZE + HEADER_SIZE;
+  recorder->log_size = 0;
+  recorder->keyframe_interval = record_keyframe_interval;
+  recorder->shadow = NULL;
+  recorder->keyframes = NULL;
+  recorder->keyframes_len = 0;
+  recorder->keyframes_cap = 0;
+  recorder->async = NULL;
 
-  uint8_t buf[HEADER_SIZE];
+  uint64_t buf[(PREFIX_SIZE + HEADER_SIZE) / sizeof (uint64_t)];
+  uint8_t *prefix = (uint8_t *)buf;
+  uint8_t *header = prefix + PREFIX_SIZE;
 
-  *header_checksum (buf) = 0;
-  *header_moves (buf) = recorder->moves;
-  *header_n_rods (buf) = pzl->n_rods;
-  *header_n_disks (buf) = pzl->n_disks;
-  *header_date (buf) = time (NULL);
-  strncpy (header_username (buf), username, MAX_USERNAME_LEN);
+  *prefix_magic (prefix) = HANOI_RECORD_MAGIC;
+  *prefix_version (prefix) = recorder->version;
+  *prefix_flags (prefix) = recorder->keyframe_interval > 0 ? HANOI_RECORD_FLAG_KEYFRAMES : 0;
+  *header_checksum (header) = 0;
+  *header_moves (header) = recorder->moves;
+  *header_n_rods (header) = n_rods;
+  *header_n_disks (header) = n_disks;
+  *header_date (header) = recorder->date;
+  memcpy (header_username (header), recorder->username, MAX_USERNAME_LEN);
 
-  if (!(write (fd, buf, sizeof (buf)) != -1
-        && write (fd, pzl->state[0], sizeof (pzl->state[0][0]) * pzl->n_rods * pzl->n_disks) != -1))
+  /* The checksum and move count are not known yet, everything else is covered from here. */
+  recorder->hash = hash_words (CHECKSUM_SEED, prefix, PREFIX_SIZE);
+  recorder->hash = hash_words (recorder->hash, header + 16, HEADER_SIZE - 16);
+
+  if (write (recorder->fd, buf, sizeof (buf)) == -1)
     {
-      free (recorder->path);
-      close (fd);
+      const int error = errno;
+      hanoi_recorder_remove_file (recorder);
+      close_storage (recorder);
+      errno = error;
       return false;
     }
 
   return true;
 }
 
-void
-hanoi_free_recorder (struct hanoi_recorder *recorder)
+/**
+ * @brief Gets rid of a recorder that failed before its record was complete.
+ */
+static void
+discard_recorder (struct hanoi_recorder *recorder)
 {
-  free (recorder->path);
-  close (recorder->fd);
+  const int error = errno;
+  hanoi_recorder_remove_file (recorder);
+  hanoi_free_recorder (recorder);
+  errno = error;
 }
 
-bool
-hanoi_recorder_remove_file (struct hanoi_recorder *recorder)
+static bool
+write_snapshot (struct hanoi_recorder *recorder, const void *data, const size_t len)
 {
-  return remove (recorder->path) != -1;
+  if (write (recorder->fd, data, len) == -1)
+    {
+      discard_recorder (recorder);
+      return false;
+    }
+  recorder->hash = hash_words (recorder->hash, data, len);
+  recorder->log_start += len;
+
+  return true;
 }
 
-bool
-hanoi_recorder_push_move (struct hanoi_recorder *recorder, const uint32_t src_i,
-                          const uint32_t des_i, const uint64_t duration)
+/**
+ * @brief Starts the state used for keyframes from the puzzle the record starts with, either `pzl`
+ * or `pk`.
+ */
+static bool
+open_keyframes (struct hanoi_recorder *recorder, const struct hanoi_puzzle *pzl,
+                const struct hanoi_packed *pk)
 {
-  const uint32_t buf[] = { src_i, des_i, ((uint32_t *)&duration)[0], ((uint32_t *)&duration)[1] };
+  if (recorder->keyframe_interval == 0)
+    {
+      return true;
+    }
 
-  if (!(lseek (recorder->fd, 0, SEEK_END) != -1 && write (recorder->fd, buf, sizeof (buf)) != -1))
+  recorder->shadow = malloc (sizeof (*recorder->shadow));
+  if (recorder->shadow == NULL)
     {
+      discard_recorder (recorder);
       return false;
     }
 
-  recorder->moves += 1;
-
-  if (!(lseek (recorder->fd, 8, SEEK_SET) != -1
-        && write (recorder->fd, &recorder->moves, sizeof (recorder->moves)) != -1))
+  const enum hanoi_init_response response
+      = pzl != NULL ? hanoi_packed_init (recorder->shadow, pzl->n_rods, pzl->n_disks)
+                    : hanoi_packed_init_copy (recorder->shadow, pk);
+  if (response != HANOI_INIT_OK)
     {
+      free (recorder->shadow);
+      recorder->shadow = NULL;
+      discard_recorder (recorder);
       return false;
     }
 
+  if (pzl != NULL)
+    {
+      hanoi_packed_from_puzzle (recorder->shadow, pzl);
+    }
+
   return true;
 }
 
-bool
-hanoi_recorder_write_checksum (struct hanoi_recorder *recorder)
+/**
+ * @brief Adds a keyframe of the state after the last move. Keyframes are optional, so if memory
+ * runs out they are given up on instead of failing the move.
+ */
+static void
+push_keyframe (struct hanoi_recorder *recorder)
 {
-  uint8_t header[HEADER_SIZE];
+  const struct hanoi_packed *shadow = recorder->shadow;
+  const size_t size = keyframe_size (shadow->n_rods, shadow->n_disks);
 
-  if (!(lseek (recorder->fd, 0, SEEK_SET) != -1
-        && read (recorder->fd, header, sizeof (header)) != -1))
+  if (recorder->keyframes_len + size > recorder->keyframes_cap)
     {
-      return false;
+      const size_t cap = recorder->keyframes_cap > 0 ? recorder->keyframes_cap * 2 : size * 16;
+      uint8_t *keyframes = realloc (recorder->keyframes, cap);
+
+      if (keyframes == NULL)
+        {
+          hanoi_packed_free (recorder->shadow);
+          free (recorder->shadow);
+          recorder->shadow = NULL;
+          return;
+        }
+
+      recorder->keyframes = keyframes;
+      recorder->keyframes_cap = cap;
     }
 
-  uint64_t checksum = 142573;
-  checksum = djb2 (checksum, (header + 8), HEADER_SIZE - 8);
+  uint8_t *keyframe = recorder->keyframes + recorder->keyframes_len;
+  const uint64_t head[] = { recorder->moves, recorder->log_size, recorder->duration };
+  const uint32_t bits = rod_bits (shadow->n_rods);
+
+  memcpy (keyframe, head, sizeof (head));
+  memset (keyframe + KEYFRAME_HEAD_SIZE, 0, size - KEYFRAME_HEAD_SIZE);
 
-  size_t len = *header_const_n_rods (header) * *header_const_n_disks (header) * sizeof (uint32_t)
-               + *header_const_moves (header) * sizeof (uint32_t) * 2;
+  for (uint32_t d = 1; d <= shadow->n_disks; ++d)
+    {
+      compact_set_rod (keyframe + KEYFRAME_HEAD_SIZE, bits, d, hanoi_packed_rod (shadow, d));
+    }
 
-  uint8_t buf[512];
+  recorder->keyframes_len += size;
+}
 
-  while (true)
+bool
+hanoi_new_recorder (struct hanoi_recorder *recorder, const struct hanoi_puzzle *pzl,
+                    const char *username)
+{
+  if (!open_recorder (recorder, pzl->n_rods, pzl->n_disks, username))
     {
-      if (len > sizeof (buf))
-        {
-          if (read (recorder->fd, buf, sizeof (buf)) == -1)
-            {
-              return false;
-            }
-          checksum = djb2 (checksum, buf, sizeof (buf));
-          len -= sizeof (buf);
-        }
-      else
-        {
-          if (read (recorder->fd, buf, len) == -1)
-            {
-              return false;
-            }
-          checksum = djb2 (checksum, buf, len);
-          break;
-        }
+      return false;
     }
 
-  if (!(lseek (recorder->fd, 0, SEEK_SET) != -1
-        && write (recorder->fd, &checksum, sizeof (checksum)) != -1))
+  if (recorder->version == HANOI_RECORD_VERSION_FIXED)
     {
+      return write_snapshot (recorder, pzl->state[0],
+                             sizeof (pzl->state[0][0]) * pzl->n_rods * pzl->n_disks)
+             && open_keyframes (recorder, pzl, NULL);
+    }
+
+  const uint32_t bits = rod_bits (pzl->n_rods);
+  const size_t len = compact_snapshot_size (pzl->n_rods, pzl->n_disks);
+
+  uint8_t *snapshot = calloc (len > 0 ? len : 1, 1);
+  if (snapshot == NULL)
+    {
+      discard_recorder (recorder);
       return false;
     }
 
-  return true;
+  for (uint32_t i = 0; i < pzl->n_rods; ++i)
+    {
+      for (uint32_t j = 0; j < pzl->heights[i]; ++j)
+        {
+          compact_set_rod (snapshot, bits, pzl->state[i][j], i);
+        }
+    }
+
+  const bool written = write_snapshot (recorder, snapshot, len);
+  free (snapshot);
+
+  return written && open_keyframes (recorder, pzl, NULL);
+}
+
+/**
+ * @brief Same as `hanoi_new_recorder` for a `struct hanoi_packed`. The snapshot is written through
+ * a small buffer, so the full matrix is never held in memory.
+ */
+bool
+hanoi_new_recorder_packed (struct hanoi_recorder *recorder, const struct hanoi_packed *pk,
+                           const char *username)
+{
+  if (!open_recorder (recorder, pk->n_rods, pk->n_disks, username))
+    {
+      return false;
+    }
+
+  /* Only the last chunk can end inside a word, so chunking keeps the hash. */
+  if (recorder->version == HANOI_RECORD_VERSION_COMPACT)
+    {
+      const uint32_t bits = rod_bits (pk->n_rods);
+      uint8_t buf[4096];
+
+      /* Every chunk but the last is a whole number of words of the snapshot. */
+      const uint32_t per_chunk = 8 * sizeof (buf) / bits / 64 * 64;
+
+      for (uint32_t first = 1; first <= pk->n_disks; first += per_chunk)
+        {
+          const uint32_t left = pk->n_disks - first + 1;
+          const uint32_t n = left < per_chunk ? left : per_chunk;
+
+          memset (buf, 0, sizeof (buf));
+          for (uint32_t d = 0; d < n; ++d)
+            {
+              compact_set_rod (buf, bits, d + 1, hanoi_packed_rod (pk, first + d));
+            }
+
+          if (!write_snapshot (recorder, buf, ((size_t)n * bits + 7) / 8))
+            {
+              return false;
+            }
+        }
+
+      return open_keyframes (recorder, NULL, pk);
+    }
+
+  uint32_t buf[1024];
+  size_t len = 0;
+
+  for (uint32_t i = 0; i < pk->n_rods; ++i)
+    {
+      for (uint32_t d = pk->n_disks, j = 0; j < pk->n_disks; ++j)
+        {
+          while (d > 0 && hanoi_packed_rod (pk, d) != i)
+            {
+              --d;
+            }
+
+          buf[len++] = d > 0 ? d-- : 0;
+
+          if (len == sizeof (buf) / sizeof (buf[0])
+              || (i + 1 == pk->n_rods && j + 1 == pk->n_disks))
+            {
+              if (!write_snapshot (recorder, buf, sizeof (buf[0]) * len))
+                {
+                  return false;
+                }
+              len = 0;
+            }
+        }
+    }
+
+  return open_keyframes (recorder, NULL, pk);
+}
+
+/**
+ * Moves are put in `ring` by the game thread and written by `thread`. `head` is only advanced by
+ * the game thread and `tail` only by the writer, so neither side takes a lock to pass moves. The
+ * lock and conditions are only used to sleep: the writer sets `sleeping` while waiting for moves
+ * and the game thread sets `waiting` while the ring is full.
+ */
+struct hanoi_recorder_async
+{
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t space;
+  struct hanoi_recorder_options options;
+  uint32_t (*ring)[4];
+  size_t mask;
+  size_t threshold;
+  size_t head;
+  size_t tail;
+  bool sleeping;
+  bool waiting;
+  bool stop;
+  int error;
+  int fd;
+  off_t base;
+  off_t offset;
+  uint64_t written;
+  /* Compact records are encoded into `out` by the writer, see `encode_move`. */
+  uint8_t *out;
+  uint64_t duration;
+  bool nibbles;
+};
+
+static bool
+pwritev_all (const int fd, struct iovec *iov, int iovcnt, off_t offset)
+{
+  while (iovcnt > 0)
+    {
+      ssize_t n = pwritev (fd, iov, iovcnt, offset);
+      if (n == -1)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+          return false;
+        }
+
+      offset += n;
+
+      for (; iovcnt > 0 && (size_t)n >= iov->iov_len; ++iov, --iovcnt)
+        {
+          n -= iov->iov_len;
+        }
+      if (iovcnt > 0)
+        {
+          iov->iov_base = (uint8_t *)iov->iov_base + n;
+          iov->iov_len -= n;
+        }
+    }
+
+  return true;
+}
+
+/**
+ * @brief Writes every move in the ring with a single `pwritev` and then the move count in the
+ * header. Moves are dropped if the write fails so the game thread never blocks on a broken file;
+ * the error is kept and reported when the recorder is stopped.
+ */
+static void
+flush_async (struct hanoi_recorder_async *async)
+{
+  const size_t tail = async->tail;
+  const size_t head = __atomic_load_n (&async->head, __ATOMIC_ACQUIRE);
+
+  if (head == tail)
+    {
+      return;
+    }
+
+  const size_t n = head - tail;
+  const size_t begin = tail & async->mask;
+  const size_t first = n < async->mask + 1 - begin ? n : async->mask + 1 - begin;
+
+  struct iovec iov[2] = {
+    { .iov_base = async->ring + begin, .iov_len = first * MOVE_SIZE },
+    { .iov_base = async->ring, .iov_len = (n - first) * MOVE_SIZE },
+  };
+  int iovcnt = n == first ? 1 : 2;
+
+  if (async->out != NULL)
+    {
+      size_t len = 0;
+
+      for (size_t i = tail; i != head; ++i)
+        {
+          len += encode_move (async->out + len, async->ring[i & async->mask], &async->duration,
+                              async->nibbles);
+        }
+
+      iov[0].iov_base = async->out;
+      iov[0].iov_len = len;
+      iovcnt = 1;
+    }
+
+  const size_t len = iov[0].iov_len + (iovcnt == 2 ? iov[1].iov_len : 0);
+
+  if (async->error == 0)
+    {
+      const uint64_t start = HANOI_STATS_NOW ();
+
+      if (pwritev_all (async->fd, iov, iovcnt, async->offset))
+        {
+          async->offset += len;
+          async->written += n;
+
+          if (pwrite (async->fd, &async->written, sizeof (async->written),
+                      async->base + PREFIX_SIZE + 8)
+              == -1)
+            {
+              async->error = errno;
+            }
+#ifdef __APPLE__
+          else if (async->options.sync && fsync (async->fd) == -1)
+#else
+          else if (async->options.sync && fdatasync (async->fd) == -1)
+#endif
+            {
+              async->error = errno;
+            }
+        }
+      else
+        {
+          async->error = errno;
+        }
+
+      HANOI_STATS_RECORD (HANOI_STATS_RECORD_WRITE_NS, HANOI_STATS_NOW () - start);
+      HANOI_STATS_COUNT (HANOI_STATS_RECORD_WRITES, 1);
+      HANOI_STATS_COUNT (HANOI_STATS_RECORD_WRITE_BYTES, len);
+    }
+
+  __atomic_store_n (&async->tail, head, __ATOMIC_SEQ_CST);
+
+  if (__atomic_load_n (&async->waiting, __ATOMIC_SEQ_CST))
+    {
+      pthread_mutex_lock (&async->lock);
+      pthread_cond_broadcast (&async->space);
+      pthread_mutex_unlock (&async->lock);
+    }
+}
+
+static void *
+writer_main (void *data)
+{
+  struct hanoi_recorder_async *async = data;
+
+  while (true)
+    {
+      pthread_mutex_lock (&async->lock);
+      __atomic_store_n (&async->sleeping, true, __ATOMIC_SEQ_CST);
+
+      struct timespec deadline;
+      clock_gettime (CLOCK_REALTIME, &deadline);
+      deadline.tv_sec += async->options.interval_ms / 1000;
+      deadline.tv_nsec += (long)(async->options.interval_ms % 1000) * 1000000;
+      if (deadline.tv_nsec >= 1000000000)
+        {
+          deadline.tv_sec += 1;
+          deadline.tv_nsec -= 1000000000;
+        }
+
+      while (!async->stop
+             && __atomic_load_n (&async->head, __ATOMIC_SEQ_CST) - async->tail < async->threshold)
+        {
+          if (async->options.flush == HANOI_FLUSH_INTERVAL)
+            {
+              if (pthread_cond_timedwait (&async->wake, &async->lock, &deadline) == ETIMEDOUT)
+                {
+                  break;
+                }
+            }
+          else
+            {
+              pthread_cond_wait (&async->wake, &async->lock);
+            }
+        }
+
+      __atomic_store_n (&async->sleeping, false, __ATOMIC_SEQ_CST);
+      const bool stop = async->stop;
+      pthread_mutex_unlock (&async->lock);
+
+      /* The game thread is done pushing before it asks to stop, so this drains the ring. */
+      flush_async (async);
+
+      if (stop)
+        {
+          return NULL;
+        }
+    }
+}
+
+static void
+push_move_async (struct hanoi_recorder_async *async, const uint32_t *move)
+{
+  const size_t head = async->head;
+
+  if (head - __atomic_load_n (&async->tail, __ATOMIC_ACQUIRE) > async->mask)
+    {
+      pthread_mutex_lock (&async->lock);
+      __atomic_store_n (&async->waiting, true, __ATOMIC_SEQ_CST);
+      pthread_cond_signal (&async->wake);
+
+      while (head - __atomic_load_n (&async->tail, __ATOMIC_SEQ_CST) > async->mask)
+        {
+          pthread_cond_wait (&async->space, &async->lock);
+        }
+
+      __atomic_store_n (&async->waiting, false, __ATOMIC_SEQ_CST);
+      pthread_mutex_unlock (&async->lock);
+    }
+
+  memcpy (async->ring[head & async->mask], move, MOVE_SIZE);
+  __atomic_store_n (&async->head, head + 1, __ATOMIC_SEQ_CST);
+
+  if (head + 1 - __atomic_load_n (&async->tail, __ATOMIC_SEQ_CST) >= async->threshold
+      && __atomic_load_n (&async->sleeping, __ATOMIC_SEQ_CST))
+    {
+      pthread_mutex_lock (&async->lock);
+      pthread_cond_signal (&async->wake);
+      pthread_mutex_unlock (&async->lock);
+    }
+}
+
+/**
+ * @brief Writes what is left in the ring and stops the writer thread. The recorder is synchronous
+ * again afterwards.
+ *
+ * @return false - A write failed at some point. `errno` is set to its error.
+ */
+static bool
+stop_async (struct hanoi_recorder *recorder)
+{
+  struct hanoi_recorder_async *async = recorder->async;
+
+  pthread_mutex_lock (&async->lock);
+  async->stop = true;
+  pthread_cond_signal (&async->wake);
+  pthread_mutex_unlock (&async->lock);
+
+  pthread_join (async->thread, NULL);
+
+  const int error = async->error;
+
+  pthread_cond_destroy (&async->space);
+  pthread_cond_destroy (&async->wake);
+  pthread_mutex_destroy (&async->lock);
+  free (async->out);
+  free (async->ring);
+  free (async);
+  recorder->async = NULL;
+
+  if (error != 0)
+    {
+      errno = error;
+      return false;
+    }
+
+  return true;
+}
+
+/**
+ * @brief Moves the writes of a recorder to a background thread. `hanoi_recorder_push_move` then
+ * only copies the move into a ring buffer; the thread writes the moves in batches and updates the
+ * move count in the header once per batch, as set by `options`. The ring is drained by
+ * `hanoi_recorder_write_checksum` and `hanoi_free_recorder`.
+ *
+ * @param recorder A recorder that is not asynchronous yet.
+ * @param options
+ * @return true - The writer thread was started.
+ * @return false - The recorder stays synchronous. Check `errno`.
+ */
+bool
+hanoi_recorder_start_async (struct hanoi_recorder *recorder,
+                            const struct hanoi_recorder_options *options)
+{
+  const off_t offset = lseek (recorder->fd, 0, SEEK_END);
+  if (offset == -1)
+    {
+      return false;
+    }
+
+  struct hanoi_recorder_async *async = calloc (1, sizeof (*async));
+  if (async == NULL)
+    {
+      return false;
+    }
+
+  size_t size = 1;
+  while (size < (options->ring_size > 0 ? options->ring_size : DEFAULT_RING_SIZE))
+    {
+      size *= 2;
+    }
+
+  async->ring = malloc (size * MOVE_SIZE);
+  if (async->ring == NULL)
+    {
+      free (async);
+      return false;
+    }
+
+  if (recorder->version == HANOI_RECORD_VERSION_COMPACT)
+    {
+      async->out = malloc (size * MAX_ENCODED_MOVE);
+      if (async->out == NULL)
+        {
+          free (async->ring);
+          free (async);
+          return false;
+        }
+    }
+
+  async->options = *options;
+  async->mask = size - 1;
+  async->threshold = options->flush == HANOI_FLUSH_PER_MOVE || size == 1 ? 1 : size / 2;
+  async->fd = recorder->fd;
+  async->base = recorder->base;
+  async->offset = offset;
+  async->written = recorder->moves;
+  async->duration = recorder->duration;
+  async->nibbles = recorder->n_rods <= 16;
+
+  pthread_mutex_init (&async->lock, NULL);
+  pthread_cond_init (&async->wake, NULL);
+  pthread_cond_init (&async->space, NULL);
+
+  const int error = pthread_create (&async->thread, NULL, writer_main, async);
+  if (error != 0)
+    {
+      pthread_cond_destroy (&async->space);
+      pthread_cond_destroy (&async->wake);
+      pthread_mutex_destroy (&async->lock);
+      free (async->out);
+      free (async->ring);
+      free (async);
+      errno = error;
+      return false;
+    }
+
+  recorder->async = async;
+
+  return true;
+}
+
+/**
+ * @brief Adds the game of a recorder to the index of its segment, once.
+ */
+static bool
+index_game (struct hanoi_recorder *recorder)
+{
+  if (recorder->index_fd == -1 || recorder->indexed)
+    {
+      return true;
+    }
+
+  const off_t end = lseek (recorder->fd, 0, SEEK_END);
+  if (end == -1)
+    {
+      return false;
+    }
+
+  struct hanoi_segment_entry entry = {
+    .id = recorder->id,
+    .offset = recorder->base,
+    .size = end - recorder->base,
+    .date = recorder->date,
+    .duration = recorder->duration,
+  };
+  memcpy (entry.username, recorder->username, MAX_USERNAME_LEN);
+
+  if (write (recorder->index_fd, &entry, sizeof (entry)) != sizeof (entry))
+    {
+      return false;
+    }
+
+  recorder->indexed = true;
+
+  return true;
+}
+
+void
+hanoi_free_recorder (struct hanoi_recorder *recorder)
+{
+  if (recorder->async != NULL)
+    {
+      stop_async (recorder);
+    }
+
+  /* A game that was neither finished nor removed is kept, like an unfinished record file. */
+  index_game (recorder);
+
+  if (recorder->shadow != NULL)
+    {
+      hanoi_packed_free (recorder->shadow);
+      free (recorder->shadow);
+    }
+  free (recorder->keyframes);
+  close_storage (recorder);
+}
+
+/**
+ * @brief Removes the record, for a game that was abandoned. In a segment the record is cut off the
+ * end, which the recorder still holds.
+ */
+bool
+hanoi_recorder_remove_file (struct hanoi_recorder *recorder)
+{
+  if (recorder->index_fd != -1)
+    {
+      if (recorder->async != NULL)
+        {
+          stop_async (recorder);
+        }
+      recorder->indexed = true;
+      return ftruncate (recorder->fd, recorder->base) != -1;
+    }
+
+  return remove (recorder->path) != -1;
+}
+
+bool
+hanoi_recorder_push_move (struct hanoi_recorder *recorder, const uint32_t src_i,
+                          const uint32_t des_i, const uint64_t duration)
+{
+  const uint32_t buf[] = { src_i, des_i, ((uint32_t *)&duration)[0], ((uint32_t *)&duration)[1] };
+
+  uint8_t out[MAX_ENCODED_MOVE];
+  uint64_t last_duration = duration;
+  const void *move = buf;
+  size_t len = sizeof (buf);
+
+  /* Also done when the writer thread encodes, to know where every move starts for keyframes. */
+  if (recorder->version == HANOI_RECORD_VERSION_COMPACT)
+    {
+      last_duration = recorder->duration;
+      len = encode_move (out, buf, &last_duration, recorder->n_rods <= 16);
+      move = out;
+    }
+
+  const uint64_t start = HANOI_STATS_NOW ();
+
+  if (recorder->async != NULL)
+    {
+      push_move_async (recorder->async, buf);
+    }
+  else if (!(lseek (recorder->fd, 0, SEEK_END) != -1 && write (recorder->fd, move, len) != -1))
+    {
+      return false;
+    }
+
+  recorder->moves += 1;
+  recorder->duration = last_duration;
+  recorder->log_size += len;
+  recorder->hash = hash_words (recorder->hash, buf, sizeof (buf));
+
+  if (recorder->shadow != NULL)
+    {
+      hanoi_packed_move (recorder->shadow, src_i, des_i);
+
+      if (recorder->moves % recorder->keyframe_interval == 0)
+        {
+          push_keyframe (recorder);
+        }
+    }
+
+  if (recorder->async == NULL)
+    {
+      if (!(lseek (recorder->fd, recorder->base + PREFIX_SIZE + 8, SEEK_SET) != -1
+            && write (recorder->fd, &recorder->moves, sizeof (recorder->moves)) != -1))
+        {
+          return false;
+        }
+
+      /* The writes of an asynchronous recorder are counted by its writer thread. */
+      HANOI_STATS_RECORD (HANOI_STATS_RECORD_WRITE_NS, HANOI_STATS_NOW () - start);
+      HANOI_STATS_COUNT (HANOI_STATS_RECORD_WRITES, 1);
+      HANOI_STATS_COUNT (HANOI_STATS_RECORD_WRITE_BYTES, len + sizeof (recorder->moves));
+    }
+
+  return true;
+}
+
+static bool
+write_checksum (struct hanoi_recorder *recorder)
+{
+  if (recorder->async != NULL && !stop_async (recorder))
+    {
+      return false;
+    }
+
+  uint64_t hash = recorder->hash;
+
+  if (recorder->shadow != NULL)
+    {
+      const size_t size = keyframe_size (recorder->shadow->n_rods, recorder->shadow->n_disks);
+      const uint64_t footer[] = {
+        recorder->keyframe_interval,
+        recorder->keyframes_len / size,
+        size,
+        KEYFRAME_MAGIC,
+      };
+      struct iovec iov[2] = {
+        { .iov_base = recorder->keyframes, .iov_len = recorder->keyframes_len },
+        { .iov_base = (void *)footer, .iov_len = sizeof (footer) },
+      };
+
+      if (!pwritev_all (recorder->fd, iov, 2,
+                        recorder->base + recorder->log_start + recorder->log_size))
+        {
+          return false;
+        }
+
+      /* A keyframe is trusted by `hanoi_record_seek` as is, so the checksum has to cover them. */
+      hash = hash_words (hash, recorder->keyframes, recorder->keyframes_len);
+      hash = hash_words (hash, footer, sizeof (footer));
+    }
+
+  const uint64_t checksum = hash_finish (hash, recorder->moves);
+
+  if (pwrite (recorder->fd, &checksum, sizeof (checksum), recorder->base + PREFIX_SIZE) == -1
+      || !index_game (recorder))
+    {
+      return false;
+    }
+
+  /* The records directory without the trailing slash. The record is finished whatever happens to
+     the leaderboard, which `hanoi_leaderboard_rebuild` can always make again. */
+  char *directory = strndup (recorder_path, recorder_path_filename_offset - 1);
+
+  recorder->leaderboard_error = 0;
+
+  if (directory == NULL
+      || !hanoi_leaderboard_add (directory, recorder->n_rods, recorder->n_disks,
+                                 recorder->username, recorder->duration, recorder->moves))
+    {
+      recorder->leaderboard_error = errno != 0 ? errno : EIO;
+    }
+  free (directory);
+
+  return true;
+}
+
+/**
+ * @brief Finishes a record by writing its checksum. The checksum is kept up to date as the record
+ * is written, so nothing is read back. The game is then added to the leaderboard of the records
+ * directory, see `hanoi_leaderboard_add`. Failing to do so does not fail the record; the error is
+ * left in `recorder->leaderboard_error`.
+ *
+ * @param recorder
+ * @return true - The record is finished. `recorder->leaderboard_error` is 0 if the leaderboard was
+ * updated, otherwise the `errno` of the failure.
+ * @return false - Writing the record failed. Check `errno`.
+ */
+bool
+hanoi_recorder_write_checksum (struct hanoi_recorder *recorder)
+{
+  const uint64_t start = HANOI_STATS_NOW ();
+  const bool ok = write_checksum (recorder);
+
+  HANOI_STATS_RECORD (HANOI_STATS_RECORD_FINALIZE_NS, HANOI_STATS_NOW () - start);
+  HANOI_STATS_COUNT (HANOI_STATS_RECORD_FINALIZES, 1);
+
+  return ok;
+}
+
+/**
+ * @brief Makes a view over the bytes of a record. The sizes in the header are checked against
+ * `size` so the accessors and the iterator never read past the end.
+ *
+ * @param record Target `struct hanoi_record`.
+ * @param data Start of the record, 8 byte aligned. Must outlive `record`.
+ * @param size Amount of bytes available at `data`.
+ * @return true - `data` holds a whole record.
+ * @return false - `data` is too short or misaligned. `errno` is set to `EINVAL`.
+ */
+bool
+hanoi_record_view (struct hanoi_record *record, const void *data, const size_t size)
+{
+  const uint8_t *bytes = data;
+  const uint8_t *header = bytes;
+  uint16_t version = HANOI_RECORD_VERSION_LEGACY;
+
+  if ((uintptr_t)data % sizeof (uint64_t) != 0 || size < PREFIX_SIZE + HEADER_SIZE)
+    {
+      errno = EINVAL;
+      return false;
+    }
+
+  /* Legacy records start with the checksum. One matching the magic by chance fails the checks
+     below or its checksum. */
+  if (*prefix_const_magic (bytes) == HANOI_RECORD_MAGIC)
+    {
+      version = *prefix_const_version (bytes);
+      header = bytes + PREFIX_SIZE;
+    }
+
+  size_t available = size - (header - bytes);
+  const uint32_t n_rods = *header_const_n_rods (header);
+  const uint32_t n_disks = *header_const_n_disks (header);
+  const uint64_t n_moves = *header_const_moves (header);
+  uint64_t len;
+
+  if (version > HANOI_RECORD_VERSION)
+    {
+      errno = EINVAL;
+      return false;
+    }
+
+  record->keyframes = NULL;
+  record->n_keyframes = 0;
+  record->keyframe_interval = 0;
+  record->keyframe_size = keyframe_size (n_rods, n_disks);
+
+  /* A record that was never finished has no index, its moves just run to the end. */
+  if (version != HANOI_RECORD_VERSION_LEGACY
+      && (*prefix_const_flags (bytes) & HANOI_RECORD_FLAG_KEYFRAMES) != 0
+      && available >= HEADER_SIZE + FOOTER_SIZE)
+    {
+      uint64_t footer[4];
+      memcpy (footer, header + available - FOOTER_SIZE, FOOTER_SIZE);
+
+      if (footer[3] == KEYFRAME_MAGIC && footer[2] == record->keyframe_size && footer[0] > 0
+          && footer[1] <= (available - HEADER_SIZE - FOOTER_SIZE) / footer[2])
+        {
+          available -= FOOTER_SIZE + footer[1] * footer[2];
+          record->keyframes = header + available;
+          record->n_keyframes = footer[1];
+          record->keyframe_interval = footer[0];
+        }
+    }
+
+  if (version == HANOI_RECORD_VERSION_COMPACT)
+    {
+      /* Moves take at least two bytes, the exact length is only known by reading them. */
+      len = HEADER_SIZE + compact_snapshot_size (n_rods, n_disks);
+      if (len > available || n_moves > (available - len) / 2)
+        {
+          errno = EINVAL;
+          return false;
+        }
+      len = available;
+    }
+  else if (__builtin_mul_overflow ((uint64_t)n_rods, n_disks * sizeof (uint32_t), &len)
+           || __builtin_add_overflow (len, HEADER_SIZE, &len) || len > available
+           || n_moves > (available - len) / MOVE_SIZE)
+    {
+      errno = EINVAL;
+      return false;
+    }
+  else
+    {
+      len += n_moves * MOVE_SIZE;
+    }
+
+  record->data = bytes;
+  record->header = header;
+  record->size = (header - bytes) + len;
+  record->version = version;
+
+  return true;
+}
+
+/**
+ * @brief Maps a record file into memory. A succsessfull open must be closed using
+ * `hanoi_record_close`.
+ *
+ * @param file Target `struct hanoi_record_file`.
+ * @param path Path of the record.
+ * @return true - `file->record` is a view over the mapped file.
+ * @return false - The file could not be mapped or is not a record. Check `errno`.
+ */
+bool
+hanoi_record_open (struct hanoi_record_file *file, const char *path)
+{
+  const int fd = open (path, O_RDONLY);
+  if (fd == -1)
+    {
+      return false;
+    }
+
+  struct stat st;
+  if (fstat (fd, &st) == -1)
+    {
+      close (fd);
+      return false;
+    }
+
+  if (st.st_size < (off_t)(PREFIX_SIZE + HEADER_SIZE))
+    {
+      close (fd);
+      errno = EINVAL;
+      return false;
+    }
+
+  file->map_len = st.st_size;
+  file->map = mmap (NULL, file->map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+
+  if (file->map == MAP_FAILED)
+    {
+      return false;
+    }
+
+  madvise (file->map, file->map_len, MADV_SEQUENTIAL);
+
+  if (!hanoi_record_view (&file->record, file->map, file->map_len))
+    {
+      munmap (file->map, file->map_len);
+      errno = EINVAL;
+      return false;
+    }
+
+  return true;
+}
+
+void
+hanoi_record_close (struct hanoi_record_file *file)
+{
+  munmap (file->map, file->map_len);
+}
+
+uint64_t
+hanoi_record_checksum (const struct hanoi_record *record)
+{
+  return *header_const_checksum (record->header);
+}
+
+/**
+ * @brief Tells a game that was never finished from one that was. The checksum stays 0 until
+ * `hanoi_recorder_write_checksum`, and a finished record hashing to 0 is taken to be unfinished.
+ *
+ * @param record
+ * @return true - The record has a checksum, which may still be wrong.
+ * @return false - The game was never finished, there is no checksum to check.
+ */
+bool
+hanoi_record_finished (const struct hanoi_record *record)
+{
+  return hanoi_record_checksum (record) != 0;
+}
+
+uint64_t
+hanoi_record_n_moves (const struct hanoi_record *record)
+{
+  return *header_const_moves (record->header);
+}
+
+uint32_t
+hanoi_record_n_rods (const struct hanoi_record *record)
+{
+  return *header_const_n_rods (record->header);
+}
+
+uint32_t
+hanoi_record_n_disks (const struct hanoi_record *record)
+{
+  return *header_const_n_disks (record->header);
+}
+
+uint64_t
+hanoi_record_date (const struct hanoi_record *record)
+{
+  return *header_const_date (record->header);
+}
+
+/**
+ * @brief Gets the name of the player.
+ *
+ * @param record
+ * @return const char* - At most `HANOI_RECORD_MAX_USERNAME_LEN` bytes, only null terminated if
+ * shorter than that.
+ */
+const char *
+hanoi_record_username (const struct hanoi_record *record)
+{
+  return header_const_username (record->header);
+}
+
+static size_t
+snapshot_size (const struct hanoi_record *record)
+{
+  if (record->version == HANOI_RECORD_VERSION_COMPACT)
+    {
+      return compact_snapshot_size (hanoi_record_n_rods (record), hanoi_record_n_disks (record));
+    }
+
+  return sizeof (uint32_t) * hanoi_record_n_rods (record) * hanoi_record_n_disks (record);
+}
+
+/**
+ * @brief Gets the state the game started from, laid out like `struct hanoi_puzzle` state.
+ *
+ * @param record
+ * @return const uint32_t* - `n_rods * n_disks` cells, or `NULL` for compact records, which keep
+ * the rod of every disk instead. See `hanoi_record_load_snapshot`.
+ */
+const uint32_t *
+hanoi_record_snapshot (const struct hanoi_record *record)
+{
+  if (record->version == HANOI_RECORD_VERSION_COMPACT)
+    {
+      return NULL;
+    }
+
+  return header_const_puzzle (record->header);
+}
+
+/**
+ * @brief Loads a compact snapshot, the rod of every disk. Any rod for every disk is a legal state,
+ * stacking from the largest disk keeps every rod ordered.
+ */
+static bool
+load_compact (struct hanoi_puzzle *pzl, const uint8_t *snapshot)
+{
+  const uint32_t bits = rod_bits (pzl->n_rods);
+
+  for (uint32_t i = 0; i < pzl->n_rods; ++i)
+    {
+      for (uint32_t j = 0; j < pzl->n_disks; ++j)
+        {
+          pzl->state[i][j] = 0;
+        }
+      pzl->heights[i] = 0;
+    }
+
+  for (uint32_t d = pzl->n_disks; d > 0; --d)
+    {
+      const uint32_t i = compact_get_rod (snapshot, bits, d);
+      if (i >= pzl->n_rods)
+        {
+          errno = EINVAL;
+          return false;
+        }
+      pzl->state[i][pzl->heights[i]++] = d;
+    }
+
+  pzl->complete_rod = HANOI_INCOMPLETE;
+
+  for (uint32_t i = 0; i < pzl->n_rods; ++i)
+    {
+      if (pzl->heights[i] == pzl->n_disks && pzl->n_disks > 0)
+        {
+          pzl->complete_rod = i;
+        }
+    }
+
+  return true;
+}
+
+/**
+ * @brief Sets a puzzle to the state the game started from, whatever the version of the record.
+ *
+ * @param record
+ * @param pzl Puzzle with the same amount of rods and disks as the record.
+ * @return true - The state was loaded.
+ * @return false - The snapshot is not a legal state. `errno` is set to `EINVAL`.
+ */
+bool
+hanoi_record_load_snapshot (const struct hanoi_record *record, struct hanoi_puzzle *pzl)
+{
+  if (record->version != HANOI_RECORD_VERSION_COMPACT)
+    {
+      return hanoi_load_state (pzl, hanoi_record_snapshot (record));
+    }
+
+  return load_compact (pzl, record->header + HEADER_SIZE);
+}
+
+/**
+ * @brief Checks the checksum written by `hanoi_recorder_write_checksum`. Legacy records were
+ * checked with djb2 over only the first half of the move log, which is kept as is.
+ *
+ * @param record
+ * @return true - The checksum matches.
+ * @return false - The record was altered, truncated or never finished.
+ */
+bool
+hanoi_record_checksum_valid (const struct hanoi_record *record)
+{
+  const uint8_t *snapshot = record->header + HEADER_SIZE;
+  const size_t len = snapshot_size (record);
+  const uint64_t n_moves = hanoi_record_n_moves (record);
+
+  if (record->version == HANOI_RECORD_VERSION_LEGACY)
+    {
+      return djb2 (CHECKSUM_SEED, record->header + 8,
+                   HEADER_SIZE - 8 + len + n_moves * sizeof (uint32_t) * 2)
+             == hanoi_record_checksum (record);
+    }
+
+  uint64_t hash = hash_words (CHECKSUM_SEED, record->data, PREFIX_SIZE);
+  hash = hash_words (hash, record->header + 16, HEADER_SIZE - 16);
+  hash = hash_words (hash, snapshot, len);
+
+  /* Moves are hashed as the recorder got them, whatever their encoding. */
+  struct hanoi_record_iterator it;
+  struct hanoi_record_move move;
+
+  hanoi_record_iterator_init (&it, record);
+
+  while (hanoi_record_iterator_next (&it, &move))
+    {
+      uint32_t buf[] = { move.src_i, move.des_i, 0, 0 };
+      memcpy (&buf[2], &move.duration, sizeof (move.duration));
+      hash = hash_words (hash, buf, sizeof (buf));
+    }
+
+  if (record->keyframes != NULL)
+    {
+      hash = hash_words (hash, record->keyframes, record->n_keyframes * record->keyframe_size);
+      hash = hash_words (hash, record->keyframes + record->n_keyframes * record->keyframe_size,
+                         FOOTER_SIZE);
+    }
+
+  return it.remaining == 0 && hash_finish (hash, n_moves) == hanoi_record_checksum (record);
+}
+
+/**
+ * @brief Replays a record and checks that every keyframe is the move, log offset, duration and
+ * state it claims to be. `hanoi_record_checksum_valid` already covers the keyframes; this also
+ * catches a recorder that wrote wrong ones.
+ *
+ * @param record
+ * @return true - The record has no keyframes or all of them match the replay.
+ * @return false - A keyframe does not match or the record is not legal. Check `errno`.
+ */
+bool
+hanoi_record_keyframes_valid (const struct hanoi_record *record)
+{
+  if (record->keyframes == NULL)
+    {
+      return true;
+    }
+
+  struct hanoi_puzzle pzl;
+  if (hanoi_init (&pzl, hanoi_record_n_rods (record), hanoi_record_n_disks (record))
+      != HANOI_INIT_OK)
+    {
+      return false;
+    }
+
+  struct hanoi_record_iterator it;
+  struct hanoi_record_move move = { .duration = 0 };
+  const uint32_t bits = rod_bits (pzl.n_rods);
+  bool ok = hanoi_record_load_snapshot (record, &pzl);
+  uint64_t played = 0;
+
+  hanoi_record_iterator_init (&it, record);
+
+  const uint8_t *log = it.next;
+
+  for (uint64_t i = 0; ok && i < record->n_keyframes; ++i)
+    {
+      const uint8_t *keyframe = record->keyframes + i * record->keyframe_size;
+      uint64_t head[3];
+
+      memcpy (head, keyframe, sizeof (head));
+      ok = head[0] == (i + 1) * record->keyframe_interval;
+
+      for (; ok && played < head[0]; ++played)
+        {
+          ok = hanoi_record_iterator_next (&it, &move) && move.src_i < pzl.n_rods
+               && move.des_i < pzl.n_rods && hanoi_move (&pzl, move.src_i, move.des_i);
+        }
+
+      ok = ok && head[1] == (uint64_t)(it.next - log) && head[2] == move.duration;
+
+      /* Every disk is on exactly one rod, so checking the rod of each covers the whole state. */
+      for (uint32_t r = 0; ok && r < pzl.n_rods; ++r)
+        {
+          for (uint32_t h = 0; ok && h < pzl.heights[r]; ++h)
+            {
+              ok = compact_get_rod (keyframe + KEYFRAME_HEAD_SIZE, bits, pzl.state[r][h]) == r;
+            }
+        }
+    }
+
+  hanoi_free (&pzl);
+
+  if (!ok)
+    {
+      errno = EINVAL;
+    }
+
+  return ok;
+}
+
+void
+hanoi_record_iterator_init (struct hanoi_record_iterator *it, const struct hanoi_record *record)
+{
+  it->next = record->header + HEADER_SIZE + snapshot_size (record);
+  it->end = record->data + record->size;
+  it->remaining = hanoi_record_n_moves (record);
+  it->duration = 0;
+  it->version = record->version;
+  it->nibbles = hanoi_record_n_rods (record) <= 16;
+}
+
+/**
+ * @brief Reads the next move of a record.
+ *
+ * @param it
+ * @param move Target `struct hanoi_record_move`.
+ * @return true - `move` was set.
+ * @return false - There are no more moves. If `it->remaining` is not 0 the log ended early or
+ * could not be decoded.
+ */
+bool
+hanoi_record_iterator_next (struct hanoi_record_iterator *it, struct hanoi_record_move *move)
+{
+  if (it->remaining == 0)
+    {
+      return false;
+    }
+
+  if (it->version != HANOI_RECORD_VERSION_COMPACT)
+    {
+      if ((size_t)(it->end - it->next) < MOVE_SIZE)
+        {
+          return false;
+        }
+
+      memcpy (&move->src_i, it->next, sizeof (uint32_t));
+      memcpy (&move->des_i, it->next + 4, sizeof (uint32_t));
+      memcpy (&move->duration, it->next + 8, sizeof (uint64_t));
+      it->next += MOVE_SIZE;
+      it->remaining -= 1;
+
+      return true;
+    }
+
+  const uint8_t *next = it->next;
+  uint64_t src_i;
+  uint64_t des_i;
+  uint64_t delta;
+
+  if (it->nibbles)
+    {
+      if (next == it->end)
+        {
+          return false;
+        }
+      src_i = *next >> 4;
+      des_i = *next++ & 0xf;
+    }
+  else if (!get_varint (&next, it->end, &src_i) || !get_varint (&next, it->end, &des_i))
+    {
+      return false;
+    }
+
+  if (!get_varint (&next, it->end, &delta))
+    {
+      return false;
+    }
+
+  it->duration += (delta >> 1) ^ -(delta & 1);
+  it->next = next;
+  it->remaining -= 1;
+
+  move->src_i = src_i > UINT32_MAX ? UINT32_MAX : src_i;
+  move->des_i = des_i > UINT32_MAX ? UINT32_MAX : des_i;
+  move->duration = it->duration;
+
+  return true;
+}
+
+/**
+ * @brief Sets a puzzle to the state after the first `k` moves of a record, starting from the last
+ * keyframe before move `k` if the record has them, and readies an iterator to read move `k` next.
+ * Keyframes are taken as they are, so a record from an untrusted source should pass
+ * `hanoi_record_checksum_valid` first.
+ *
+ * @param record
+ * @param k Amount of moves to play, at most the amount in the record.
+ * @param pzl Puzzle with the same amount of rods and disks as the record.
+ * @param it Target `struct hanoi_record_iterator`.
+ * @return true - `pzl` and `it` are at move `k`.
+ * @return false - `k` is out of range, the sizes differ or the record is not legal up to move `k`.
+ * `errno` is set to `EINVAL`.
+ */
+bool
+hanoi_record_seek (const struct hanoi_record *record, const uint64_t k, struct hanoi_puzzle *pzl,
+                   struct hanoi_record_iterator *it)
+{
+  if (k > hanoi_record_n_moves (record) || pzl->n_rods != hanoi_record_n_rods (record)
+      || pzl->n_disks != hanoi_record_n_disks (record))
+    {
+      errno = EINVAL;
+      return false;
+    }
+
+  hanoi_record_iterator_init (it, record);
+
+  const uint64_t j = record->n_keyframes > 0 ? k / record->keyframe_interval : 0;
+  const uint8_t *log = it->next;
+  uint64_t played = 0;
+
+  if (j > 0)
+    {
+      const uint64_t i = (j < record->n_keyframes ? j : record->n_keyframes) - 1;
+      const uint8_t *keyframe = record->keyframes + i * record->keyframe_size;
+      uint64_t head[3];
+
+      memcpy (head, keyframe, sizeof (head));
+
+      /* Anything off about the keyframe and it is ignored in favour of the snapshot. */
+      if (head[0] <= k && head[0] <= hanoi_record_n_moves (record)
+          && head[1] <= (size_t)(it->end - log)
+          && load_compact (pzl, keyframe + KEYFRAME_HEAD_SIZE))
+        {
+          it->next = log + head[1];
+          it->remaining -= head[0];
+          it->duration = head[2];
+          played = head[0];
+        }
+    }
+
+  if (played == 0 && !hanoi_record_load_snapshot (record, pzl))
+    {
+      return false;
+    }
+
+  struct hanoi_record_move move;
+
+  for (; played < k; ++played)
+    {
+      if (!hanoi_record_iterator_next (it, &move) || move.src_i >= pzl->n_rods
+          || move.des_i >= pzl->n_rods || !hanoi_move (pzl, move.src_i, move.des_i))
+        {
+          errno = EINVAL;
+          return false;
+        }
+    }
+
+  return true;
+}
+
+/**
+ * @brief Plays a record from its snapshot on a puzzle.
+ *
+ * @param record
+ * @param pzl Puzzle with the same amount of rods and disks as the record. Holds the state after
+ * the last legal move when done.
+ * @param n_played Set to the amount of moves that were made. On `HANOI_REPLAY_ILLEGAL_MOVE` it is
+ * the index of the first illegal move.
+ * @return HANOI_REPLAY_OK - Every move was legal.
+ * @return HANOI_REPLAY_SIZE_MISMATCH - `pzl` has a different size than the record.
+ * @return HANOI_REPLAY_ILLEGAL_STATE - The snapshot is not a legal state.
+ * @return HANOI_REPLAY_ILLEGAL_MOVE - A move was not allowed or used a rod out of range.
+ * @return HANOI_REPLAY_TRUNCATED - The move log ended before the last move.
+ */
+enum hanoi_replay_response
+hanoi_record_replay (const struct hanoi_record *record, struct hanoi_puzzle *pzl,
+                     uint64_t *n_played)
+{
+  *n_played = 0;
+
+  if (pzl->n_rods != hanoi_record_n_rods (record) || pzl->n_disks != hanoi_record_n_disks (record))
+    {
+      return HANOI_REPLAY_SIZE_MISMATCH;
+    }
+
+  if (!hanoi_record_load_snapshot (record, pzl))
+    {
+      return HANOI_REPLAY_ILLEGAL_STATE;
+    }
+
+  struct hanoi_record_iterator it;
+  struct hanoi_record_move move;
+
+  hanoi_record_iterator_init (&it, record);
+
+  while (hanoi_record_iterator_next (&it, &move))
+    {
+      if (move.src_i >= pzl->n_rods || move.des_i >= pzl->n_rods
+          || !hanoi_move (pzl, move.src_i, move.des_i))
+        {
+          return HANOI_REPLAY_ILLEGAL_MOVE;
+        }
+      *n_played += 1;
+    }
+
+  return it.remaining == 0 ? HANOI_REPLAY_OK : HANOI_REPLAY_TRUNCATED;
 }
\ No newline at end of file
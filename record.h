@@ -2,24 +2,126 @@
 #define RECORD_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "hanoi.h"
+#include "packed.h"
+
+#define HANOI_RECORD_MAX_USERNAME_LEN 32
+
+/* "HNOI", the first word of every versioned record. Legacy records have no prefix. */
+#define HANOI_RECORD_MAGIC 0x494f4e48
+#define HANOI_RECORD_VERSION_LEGACY 0
+/* 16 byte moves and a `n_rods * n_disks` snapshot, like legacy records. */
+#define HANOI_RECORD_VERSION_FIXED 1
+/* Rod of every disk as the snapshot, moves as packed rods and a varint duration delta. */
+#define HANOI_RECORD_VERSION_COMPACT 2
+#define HANOI_RECORD_VERSION HANOI_RECORD_VERSION_COMPACT
+
+/* The record ends with keyframes and an index to them, see `hanoi_set_record_keyframes`. */
+#define HANOI_RECORD_FLAG_KEYFRAMES 0x1
+
+struct hanoi_recorder_async;
+
+/**
+ * Where new records go, see `hanoi_set_record_storage`.
+ */
+enum hanoi_record_storage
+{
+  HANOI_RECORD_STORAGE_FILES,
+  HANOI_RECORD_STORAGE_SEGMENTS,
+};
+
+/**
+ * Entry of the index kept next to every segment, one per game in the order they were added.
+ */
+struct hanoi_segment_entry
+{
+  uint64_t id;
+  uint64_t offset;
+  uint64_t size;
+  uint64_t date;
+  uint64_t duration;
+  char username[HANOI_RECORD_MAX_USERNAME_LEN];
+};
 
 struct hanoi_recorder
 {
   int fd;
+  /* Offset of the record in the file, which is a segment if `index_fd` is not -1. */
+  int64_t base;
+  int index_fd;
+  uint64_t id;
+  bool indexed;
+  uint64_t date;
+  char username[HANOI_RECORD_MAX_USERNAME_LEN];
   uint64_t moves;
+  uint64_t hash;
+  uint16_t version;
+  uint32_t n_rods;
+  uint32_t n_disks;
+  uint64_t duration;
+  /* Offset of the move log in the file and its size so far. */
+  uint64_t log_start;
+  uint64_t log_size;
+  uint32_t keyframe_interval;
+  /* State after the last move, only kept while making keyframes. */
+  struct hanoi_packed *shadow;
+  uint8_t *keyframes;
+  size_t keyframes_len;
+  size_t keyframes_cap;
   char *path;
+  struct hanoi_recorder_async *async;
+  /* `errno` of a failed leaderboard update when the record was finished, otherwise 0. */
+  int leaderboard_error;
+};
+
+/**
+ * When an asynchronous recorder writes the moves it was given, see `hanoi_recorder_start_async`.
+ */
+enum hanoi_flush_policy
+{
+  HANOI_FLUSH_PER_MOVE,
+  HANOI_FLUSH_INTERVAL,
+  HANOI_FLUSH_ON_COMPLETION,
+};
+
+struct hanoi_recorder_options
+{
+  enum hanoi_flush_policy flush;
+  /* Time between writes with `HANOI_FLUSH_INTERVAL`. */
+  uint32_t interval_ms;
+  /* Sync the data to disk after every write. */
+  bool sync;
+  /* Amount of moves that can wait to be written, rounded up to a power of two. 0 for default. */
+  uint32_t ring_size;
 };
 
 void
 hanoi_set_records_directory (const char *path);
 
+bool
+hanoi_set_record_version (const uint16_t version);
+
+void
+hanoi_set_record_keyframes (const uint32_t interval);
+
+void
+hanoi_set_record_storage (const enum hanoi_record_storage storage, const uint64_t segment_size);
+
 bool
 hanoi_new_recorder (struct hanoi_recorder *recorder, const struct hanoi_puzzle *pzl,
                     const char *username);
 
+bool
+hanoi_new_recorder_packed (struct hanoi_recorder *recorder, const struct hanoi_packed *pk,
+                           const char *username);
+
+bool
+hanoi_recorder_start_async (struct hanoi_recorder *recorder,
+                            const struct hanoi_recorder_options *options);
+
 bool
 hanoi_recorder_remove_file (struct hanoi_recorder *recorder);
 
@@ -33,4 +135,114 @@ hanoi_recorder_push_move (struct hanoi_recorder *recorder, const uint32_t src_i,
 bool
 hanoi_recorder_write_checksum (struct hanoi_recorder *recorder);
 
+/**
+ * Read only view over the bytes of one record, wherever they are kept. Nothing is copied; every
+ * accessor reads straight from `data`, which must be 8 byte aligned. `header` is where the fields
+ * shared by every version start, after the prefix of versioned records.
+ */
+struct hanoi_record
+{
+  const uint8_t *data;
+  const uint8_t *header;
+  size_t size;
+  uint16_t version;
+  /* Index after the move log, `n_keyframes` entries of `keyframe_size` bytes. */
+  const uint8_t *keyframes;
+  uint64_t n_keyframes;
+  uint64_t keyframe_interval;
+  size_t keyframe_size;
+};
+
+/**
+ * Record file mapped into memory, see `hanoi_record_open`.
+ */
+struct hanoi_record_file
+{
+  void *map;
+  size_t map_len;
+  struct hanoi_record record;
+};
+
+struct hanoi_record_move
+{
+  uint32_t src_i;
+  uint32_t des_i;
+  uint64_t duration;
+};
+
+struct hanoi_record_iterator
+{
+  const uint8_t *next;
+  const uint8_t *end;
+  uint64_t remaining;
+  uint64_t duration;
+  uint16_t version;
+  bool nibbles;
+};
+
+enum hanoi_replay_response
+{
+  HANOI_REPLAY_OK,
+  HANOI_REPLAY_SIZE_MISMATCH,
+  HANOI_REPLAY_ILLEGAL_STATE,
+  HANOI_REPLAY_ILLEGAL_MOVE,
+  HANOI_REPLAY_TRUNCATED,
+};
+
+bool
+hanoi_record_view (struct hanoi_record *record, const void *data, const size_t size);
+
+bool
+hanoi_record_open (struct hanoi_record_file *file, const char *path);
+
+void
+hanoi_record_close (struct hanoi_record_file *file);
+
+uint64_t
+hanoi_record_checksum (const struct hanoi_record *record);
+
+bool
+hanoi_record_finished (const struct hanoi_record *record);
+
+uint64_t
+hanoi_record_n_moves (const struct hanoi_record *record);
+
+uint32_t
+hanoi_record_n_rods (const struct hanoi_record *record);
+
+uint32_t
+hanoi_record_n_disks (const struct hanoi_record *record);
+
+uint64_t
+hanoi_record_date (const struct hanoi_record *record);
+
+const char *
+hanoi_record_username (const struct hanoi_record *record);
+
+const uint32_t *
+hanoi_record_snapshot (const struct hanoi_record *record);
+
+bool
+hanoi_record_load_snapshot (const struct hanoi_record *record, struct hanoi_puzzle *pzl);
+
+bool
+hanoi_record_checksum_valid (const struct hanoi_record *record);
+
+bool
+hanoi_record_keyframes_valid (const struct hanoi_record *record);
+
+void
+hanoi_record_iterator_init (struct hanoi_record_iterator *it, const struct hanoi_record *record);
+
+bool
+hanoi_record_iterator_next (struct hanoi_record_iterator *it, struct hanoi_record_move *move);
+
+bool
+hanoi_record_seek (const struct hanoi_record *record, const uint64_t k, struct hanoi_puzzle *pzl,
+                   struct hanoi_record_iterator *it);
+
+enum hanoi_replay_response
+hanoi_record_replay (const struct hanoi_record *record, struct hanoi_puzzle *pzl,
+                     uint64_t *n_played);
+
 #endif /* RECORD_H */
\ No newline at end of file
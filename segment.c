@@ -0,0 +1,143 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "record.h"
+#include "segment.h"
+
+#define SEGMENT_EXTENSION ".hanoi-segment"
+#define INDEX_EXTENSION ".hanoi-index"
+
+/**
+ * @brief Maps a whole file read only. An empty file gives a NULL map.
+ */
+static bool
+map_file (const char *path, void **map, size_t *map_len)
+{
+  const int fd = open (path, O_RDONLY);
+  if (fd == -1)
+    {
+      return false;
+    }
+
+  struct stat st;
+  if (fstat (fd, &st) == -1)
+    {
+      close (fd);
+      return false;
+    }
+
+  *map = NULL;
+  *map_len = st.st_size;
+
+  if (*map_len > 0)
+    {
+      *map = mmap (NULL, *map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+  close (fd);
+
+  return *map != MAP_FAILED;
+}
+
+static void
+unmap_file (void *map, const size_t map_len)
+{
+  if (map != NULL)
+    {
+      munmap (map, map_len);
+    }
+}
+
+/**
+ * @brief Maps a segment written with `HANOI_RECORD_STORAGE_SEGMENTS` and the index next to it. The
+ * segment may still be written to; only the games in the index at the time of opening are read.
+ * A successfull open must be closed using `hanoi_segment_close`.
+ *
+ * @param segment Target `struct hanoi_segment`.
+ * @param path Path of the `.hanoi-segment` file.
+ * @return true - The segment was opened.
+ * @return false - The path is not a segment or a system call failed. Check `errno`.
+ */
+bool
+hanoi_segment_open (struct hanoi_segment *segment, const char *path)
+{
+  const size_t len = strlen (path);
+  const size_t extension_len = strlen (SEGMENT_EXTENSION);
+
+  if (len < extension_len || strcmp (path + len - extension_len, SEGMENT_EXTENSION) != 0)
+    {
+      errno = EINVAL;
+      return false;
+    }
+
+  char *index_path = malloc (len - extension_len + strlen (INDEX_EXTENSION) + 1);
+  if (index_path == NULL)
+    {
+      return false;
+    }
+  memcpy (index_path, path, len - extension_len);
+  strcpy (index_path + len - extension_len, INDEX_EXTENSION);
+
+  /* The index is mapped first so every game in it is already in the segment. */
+  const bool index_mapped = map_file (index_path, &segment->index_map, &segment->index_len);
+  free (index_path);
+
+  if (!index_mapped)
+    {
+      return false;
+    }
+
+  if (!map_file (path, &segment->map, &segment->map_len))
+    {
+      const int error = errno;
+      unmap_file (segment->index_map, segment->index_len);
+      errno = error;
+      return false;
+    }
+
+  segment->entries = segment->index_map;
+  segment->n_entries = segment->index_len / sizeof (struct hanoi_segment_entry);
+
+  return true;
+}
+
+void
+hanoi_segment_close (struct hanoi_segment *segment)
+{
+  unmap_file (segment->map, segment->map_len);
+  unmap_file (segment->index_map, segment->index_len);
+}
+
+/**
+ * @brief Sets `record` to view game `i` of a segment, in the order the games were added.
+ *
+ * @param segment
+ * @param i Index of the game, less than `segment->n_entries`.
+ * @param record Target `struct hanoi_record`.
+ * @return true - The game was found.
+ * @return false - The index entry does not point at a record in the segment.
+ */
+bool
+hanoi_segment_record (const struct hanoi_segment *segment, const size_t i,
+                      struct hanoi_record *record)
+{
+  if (i >= segment->n_entries)
+    {
+      return false;
+    }
+
+  const struct hanoi_segment_entry *entry = &segment->entries[i];
+
+  if (entry->offset > segment->map_len || entry->size > segment->map_len - entry->offset)
+    {
+      return false;
+    }
+
+  return hanoi_record_view (record, (const char *)segment->map + entry->offset, entry->size);
+}
@@ -0,0 +1,32 @@
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "record.h"
+
+/**
+ * Segment of records and its index mapped into memory, see `hanoi_segment_open`.
+ */
+struct hanoi_segment
+{
+  void *map;
+  size_t map_len;
+  void *index_map;
+  size_t index_len;
+  const struct hanoi_segment_entry *entries;
+  size_t n_entries;
+};
+
+bool
+hanoi_segment_open (struct hanoi_segment *segment, const char *path);
+
+void
+hanoi_segment_close (struct hanoi_segment *segment);
+
+bool
+hanoi_segment_record (const struct hanoi_segment *segment, const size_t i,
+                      struct hanoi_record *record);
+
+#endif /* SEGMENT_H */
\ No newline at end of file
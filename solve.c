@@ -0,0 +1,474 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "hanoi.h"
+#include "solve.h"
+
+/**
+ * @brief Amount of moves in the optimal solution of a 3 rod puzzle.
+ *
+ * @param n_disks At most 64.
+ * @return uint64_t 2^n_disks - 1
+ */
+uint64_t
+hanoi_solve_n_moves (const uint32_t n_disks)
+{
+  return n_disks >= 64 ? UINT64_MAX : ((uint64_t)1 << n_disks) - 1;
+}
+
+/**
+ * @brief Gets a move from the optimal solution of a 3 rod puzzle, starting from the layout of
+ * `hanoi_init` and ending with all disks on the last rod.
+ *
+ * Move `k` moves disk `ctz(k + 1) + 1`. Which rods it moves between follows from the binary
+ * representation of `k + 1`, so any move can be computed without generating the ones before it.
+ *
+ * @param n_disks At most 64.
+ * @param k Index of the move, less than `hanoi_solve_n_moves (n_disks)`.
+ * @return struct hanoi_move
+ */
+struct hanoi_move
+hanoi_solve_move (const uint32_t n_disks, const uint64_t k)
+{
+  const uint64_t m = k + 1;
+
+  uint32_t src = (m & (m - 1)) % 3;
+  uint32_t des = ((m | (m - 1)) % 3 + 1) % 3;
+
+  /* The sequence above ends on the second rod when the amount of disks is even. */
+  if (n_disks % 2 == 0)
+    {
+      src = (3 - src) % 3;
+      des = (3 - des) % 3;
+    }
+
+  return (struct hanoi_move){ src, des };
+}
+
+void
+hanoi_solve_iterator_init (struct hanoi_solve_iterator *it, const uint32_t n_disks)
+{
+  it->n_disks = n_disks;
+  it->k = 0;
+  it->n_moves = hanoi_solve_n_moves (n_disks);
+}
+
+/**
+ * @brief Gets the next move of the solution.
+ *
+ * @param it
+ * @param move Receives the move.
+ * @return true - `move` was set.
+ * @return false - The solution has no more moves.
+ */
+bool
+hanoi_solve_iterator_next (struct hanoi_solve_iterator *it, struct hanoi_move *move)
+{
+  if (it->k == it->n_moves)
+    {
+      return false;
+    }
+
+  *move = hanoi_solve_move (it->n_disks, it->k++);
+  return true;
+}
+
+/**
+ * @brief Streams the optimal solution of a 3 rod puzzle to a callback.
+ *
+ * @param n_disks At most 64.
+ * @param callback Called with every move in order.
+ * @param data Passed on to `callback`.
+ * @return true - All moves were passed to `callback`.
+ * @return false - `callback` stopped the solver.
+ */
+bool
+hanoi_solve (const uint32_t n_disks, hanoi_move_callback callback, void *data)
+{
+  struct hanoi_solve_iterator it;
+  struct hanoi_move move;
+
+  hanoi_solve_iterator_init (&it, n_disks);
+
+  while (hanoi_solve_iterator_next (&it, &move))
+    {
+      if (!callback (&move, data))
+        {
+          return false;
+        }
+    }
+
+  return true;
+}
+
+/**
+ * @brief Finds the least amount of moves left to complete a 3 rod puzzle from any legal state, and
+ * the first move towards it, in a single pass over the disks from the largest to the smallest.
+ *
+ * Moving every disk to rod `t` takes no moves for the largest disk if it already is on `t`.
+ * Otherwise every smaller disk has to be moved to the third rod first, after which the largest disk
+ * is moved with one move and the smaller ones need 2^(d - 1) - 1 more. The first move is the one of
+ * the smallest disk not on the rod it is heading for. All three rods are followed at once.
+ *
+ * @param pzl A puzzle with 3 rods and at most 64 disks.
+ * @param exclude_i A rod not to complete the puzzle on, or `HANOI_INCOMPLETE`.
+ * @param hint Receives the result.
+ * @return true - `hint` was set.
+ * @return false - The puzzle does not have 3 rods or has more than 64 disks.
+ */
+bool
+hanoi_solve_hint (const struct hanoi_puzzle *pzl, const uint32_t exclude_i, struct hanoi_hint *hint)
+{
+  if (pzl->n_rods != 3 || pzl->n_disks > 64)
+    {
+      return false;
+    }
+
+  uint32_t targets[] = { 0, 1, 2 };
+  uint64_t n_moves[] = { 0, 0, 0 };
+  struct hanoi_move moves[3];
+  uint32_t js[] = { 0, 0, 0 };
+
+  for (uint32_t d = pzl->n_disks; d > 0; --d)
+    {
+      /* The bottom-most disk left on some rod is disk `d`. */
+      uint32_t i = 0;
+      while (js[i] == pzl->heights[i] || pzl->state[i][js[i]] != d)
+        {
+          ++i;
+        }
+      js[i] += 1;
+
+      for (uint32_t t = 0; t < 3; ++t)
+        {
+          if (i != targets[t])
+            {
+              n_moves[t] += (uint64_t)1 << (d - 1);
+              moves[t].src_i = i;
+              moves[t].des_i = targets[t];
+              targets[t] = 3 - i - targets[t];
+            }
+        }
+    }
+
+  hint->des_i = HANOI_INCOMPLETE;
+
+  for (uint32_t t = 0; t < 3; ++t)
+    {
+      if (t != exclude_i && (hint->des_i == HANOI_INCOMPLETE || n_moves[t] < hint->n_moves))
+        {
+          hint->des_i = t;
+          hint->n_moves = n_moves[t];
+          hint->move = moves[t];
+        }
+    }
+
+  return true;
+}
+
+static uint32_t
+table_index (const struct hanoi_solve_table *table, const uint32_t n_rods, const uint32_t n_disks)
+{
+  return (n_rods - 3) * (table->n_disks + 1) + n_disks;
+}
+
+/**
+ * @brief Builds the Frame-Stewart table for a puzzle. A successful init must be freed using
+ * `hanoi_solve_table_free`.
+ *
+ * For every rod count `p` from 3 up to `n_rods` and every disk count `n` up to `n_disks` the table
+ * stores the `k` minimizing `2 * moves(k, p) + moves(n - k, p - 1)`. Building it takes
+ * O(n_rods * n_disks^2) time and O(n_rods * n_disks) memory.
+ *
+ * @param table Target `struct hanoi_solve_table`.
+ * @param n_rods Amount of rods in the puzzle. At least 3.
+ * @param n_disks Amount of disks in the puzzle.
+ * @return HANOI_INIT_OK - Init successful.
+ * @return HANOI_INIT_INVALID_N_RODS_VALUE - The value of `n_rods` was set to `HANOI_INCOMPLATE`.
+ * @return HANOI_INIT_UNSUPPORTED_SIZE - Fewer than 3 rods or more than 2^64 - 1 moves.
+ * @return HANOI_INIT_SYSTEM_ERROR - System failure during init. Check `errno`.
+ */
+enum hanoi_init_response
+hanoi_solve_table_init (struct hanoi_solve_table *table, const uint32_t n_rods,
+                        const uint32_t n_disks)
+{
+  if (n_rods == HANOI_INCOMPLETE)
+    {
+      return HANOI_INIT_INVALID_N_RODS_VALUE;
+    }
+
+  if (n_rods < 3 || (n_rods == 3 && n_disks > 64))
+    {
+      return HANOI_INIT_UNSUPPORTED_SIZE;
+    }
+
+  const size_t len = (size_t)(n_rods - 2) * (n_disks + 1);
+
+  table->n_moves = malloc (sizeof (table->n_moves[0]) * len);
+  if (table->n_moves == NULL)
+    {
+      return HANOI_INIT_SYSTEM_ERROR;
+    }
+
+  table->splits = calloc (len, sizeof (table->splits[0]));
+  if (table->splits == NULL)
+    {
+      free (table->n_moves);
+      return HANOI_INIT_SYSTEM_ERROR;
+    }
+
+  table->n_rods = n_rods;
+  table->n_disks = n_disks;
+
+  for (uint32_t n = 0; n <= n_disks; ++n)
+    {
+      table->n_moves[table_index (table, 3, n)] = hanoi_solve_n_moves (n);
+    }
+
+  for (uint32_t p = 4; p <= n_rods; ++p)
+    {
+      table->n_moves[table_index (table, p, 0)] = 0;
+
+      for (uint32_t n = 1; n <= n_disks; ++n)
+        {
+          uint64_t best = UINT64_MAX;
+          uint32_t best_k = 0;
+          bool found = false;
+
+          for (uint32_t k = 0; k < n; ++k)
+            {
+              uint64_t moves;
+
+              /* More than 64 disks on 3 rods overflows, see `hanoi_solve_n_moves`. */
+              if (p == 4 && n - k > 64)
+                {
+                  continue;
+                }
+
+              if (!__builtin_mul_overflow (table->n_moves[table_index (table, p, k)], 2, &moves)
+                  && !__builtin_add_overflow (
+                      moves, table->n_moves[table_index (table, p - 1, n - k)], &moves)
+                  && (!found || moves < best))
+                {
+                  best = moves;
+                  best_k = k;
+                  found = true;
+                }
+            }
+
+          if (!found)
+            {
+              hanoi_solve_table_free (table);
+              return HANOI_INIT_UNSUPPORTED_SIZE;
+            }
+
+          table->n_moves[table_index (table, p, n)] = best;
+          table->splits[table_index (table, p, n)] = best_k;
+        }
+    }
+
+  return HANOI_INIT_OK;
+}
+
+void
+hanoi_solve_table_free (struct hanoi_solve_table *table)
+{
+  free (table->n_moves);
+  free (table->splits);
+}
+
+/**
+ * @brief Amount of moves in the Frame-Stewart solution.
+ */
+uint64_t
+hanoi_solve_table_n_moves (const struct hanoi_solve_table *table)
+{
+  return table->n_moves[table_index (table, table->n_rods, table->n_disks)];
+}
+
+static void
+initial_rods (const uint32_t n_rods, uint32_t *rods)
+{
+  rods[0] = 0;
+  rods[1] = n_rods - 1;
+
+  for (uint32_t i = 2; i < n_rods; ++i)
+    {
+      rods[i] = i - 1;
+    }
+}
+
+static struct hanoi_move
+map_move (const struct hanoi_move move, const uint32_t *rods)
+{
+  /* `hanoi_solve_move` moves from rod 0 to rod 2 using rod 1. */
+  const uint32_t map[] = { rods[0], rods[2], rods[1] };
+  return (struct hanoi_move){ map[move.src_i], map[move.des_i] };
+}
+
+/**
+ * @brief Gets a move from the Frame-Stewart solution, starting from the layout of `hanoi_init` and
+ * ending with all disks on the last rod. Walks down the recursion without generating any other
+ * move, in O(n_rods + n_disks).
+ *
+ * @param table
+ * @param k Index of the move, less than `hanoi_solve_table_n_moves (table)`.
+ * @return struct hanoi_move
+ */
+struct hanoi_move
+hanoi_solve_table_move (const struct hanoi_solve_table *table, uint64_t k)
+{
+  /* Source, destination and then the intermediate rods of the current sub-problem. */
+  uint32_t rods[table->n_rods];
+  uint32_t n = table->n_disks;
+  uint32_t p = table->n_rods;
+
+  initial_rods (table->n_rods, rods);
+
+  while (p > 3)
+    {
+      const uint32_t split = table->splits[table_index (table, p, n)];
+      const uint64_t parked = table->n_moves[table_index (table, p, split)];
+      const uint64_t rest = table->n_moves[table_index (table, p - 1, n - split)];
+      uint32_t tmp;
+
+      if (k < parked)
+        {
+          n = split;
+          tmp = rods[1];
+          rods[1] = rods[2];
+          rods[2] = tmp;
+        }
+      else if (k - parked < rest)
+        {
+          k -= parked;
+          n -= split;
+          p -= 1;
+          for (uint32_t i = 2; i < p; ++i)
+            {
+              rods[i] = rods[i + 1];
+            }
+        }
+      else
+        {
+          k -= parked + rest;
+          n = split;
+          tmp = rods[0];
+          rods[0] = rods[2];
+          rods[2] = tmp;
+        }
+    }
+
+  return map_move (hanoi_solve_move (n, k), rods);
+}
+
+void
+hanoi_solve_table_iterator_init (struct hanoi_solve_table_iterator *it,
+                                 const struct hanoi_solve_table *table)
+{
+  it->table = table;
+  it->k = 0;
+  it->n_moves = hanoi_solve_table_n_moves (table);
+}
+
+/**
+ * @brief Gets the next move of the solution.
+ *
+ * @param it
+ * @param move Receives the move.
+ * @return true - `move` was set.
+ * @return false - The solution has no more moves.
+ */
+bool
+hanoi_solve_table_iterator_next (struct hanoi_solve_table_iterator *it, struct hanoi_move *move)
+{
+  if (it->k == it->n_moves)
+    {
+      return false;
+    }
+
+  *move = hanoi_solve_table_move (it->table, it->k++);
+  return true;
+}
+
+static bool
+solve_table (const struct hanoi_solve_table *table, const uint32_t n, const uint32_t p,
+             const uint32_t *rods, hanoi_move_callback callback, void *data)
+{
+  if (n == 0)
+    {
+      return true;
+    }
+
+  if (p == 3)
+    {
+      struct hanoi_solve_iterator it;
+      struct hanoi_move move;
+
+      hanoi_solve_iterator_init (&it, n);
+
+      while (hanoi_solve_iterator_next (&it, &move))
+        {
+          move = map_move (move, rods);
+          if (!callback (&move, data))
+            {
+              return false;
+            }
+        }
+
+      return true;
+    }
+
+  const uint32_t split = table->splits[table_index (table, p, n)];
+  uint32_t sub[p];
+
+  for (uint32_t i = 0; i < p; ++i)
+    {
+      sub[i] = rods[i];
+    }
+
+  sub[1] = rods[2];
+  sub[2] = rods[1];
+  if (!solve_table (table, split, p, sub, callback, data))
+    {
+      return false;
+    }
+
+  sub[1] = rods[1];
+  for (uint32_t i = 2; i < p - 1; ++i)
+    {
+      sub[i] = rods[i + 1];
+    }
+  if (!solve_table (table, n - split, p - 1, sub, callback, data))
+    {
+      return false;
+    }
+
+  for (uint32_t i = 0; i < p; ++i)
+    {
+      sub[i] = rods[i];
+    }
+  sub[0] = rods[2];
+  sub[2] = rods[0];
+  return solve_table (table, split, p, sub, callback, data);
+}
+
+/**
+ * @brief Streams the Frame-Stewart solution to a callback.
+ *
+ * @param table
+ * @param callback Called with every move in order.
+ * @param data Passed on to `callback`.
+ * @return true - All moves were passed to `callback`.
+ * @return false - `callback` stopped the solver.
+ */
+bool
+hanoi_solve_table (const struct hanoi_solve_table *table, hanoi_move_callback callback, void *data)
+{
+  uint32_t rods[table->n_rods];
+
+  initial_rods (table->n_rods, rods);
+
+  return solve_table (table, table->n_disks, table->n_rods, rods, callback, data);
+}
@@ -0,0 +1,106 @@
+
+#ifndef SOLVE_H
+#define SOLVE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hanoi.h"
+
+struct hanoi_move
+{
+  uint32_t src_i;
+  uint32_t des_i;
+};
+
+/**
+ * Called once for every move of a solution, in order. Returning false stops the solver.
+ */
+typedef bool (*hanoi_move_callback) (const struct hanoi_move *move, void *data);
+
+/**
+ * Distance to the goal and the next optimal move of a 3 rod puzzle, see `hanoi_solve_hint`.
+ */
+struct hanoi_hint
+{
+  /* Least amount of moves left to complete the puzzle. */
+  uint64_t n_moves;
+  /* Rod the puzzle gets completed on. */
+  uint32_t des_i;
+  /* First move of an optimal solution. Only set if `n_moves` is not 0. */
+  struct hanoi_move move;
+};
+
+/**
+ * Streams the optimal solution of a 3 rod puzzle one move at a time.
+ */
+struct hanoi_solve_iterator
+{
+  uint32_t n_disks;
+  uint64_t k;
+  uint64_t n_moves;
+};
+
+/**
+ * Frame-Stewart solution for puzzles with 3 or more rods. `n_moves` and `splits` are indexed by
+ * `(rods - 3) * (n_disks + 1) + disks` and hold the move count of moving `disks` disks using
+ * `rods` rods and how many of the top disks to park on an intermediate rod while doing so.
+ */
+struct hanoi_solve_table
+{
+  uint32_t n_rods;
+  uint32_t n_disks;
+  uint64_t *n_moves;
+  uint32_t *splits;
+};
+
+struct hanoi_solve_table_iterator
+{
+  const struct hanoi_solve_table *table;
+  uint64_t k;
+  uint64_t n_moves;
+};
+
+uint64_t
+hanoi_solve_n_moves (const uint32_t n_disks);
+
+struct hanoi_move
+hanoi_solve_move (const uint32_t n_disks, const uint64_t k);
+
+void
+hanoi_solve_iterator_init (struct hanoi_solve_iterator *it, const uint32_t n_disks);
+
+bool
+hanoi_solve_iterator_next (struct hanoi_solve_iterator *it, struct hanoi_move *move);
+
+bool
+hanoi_solve (const uint32_t n_disks, hanoi_move_callback callback, void *data);
+
+bool
+hanoi_solve_hint (const struct hanoi_puzzle *pzl, const uint32_t exclude_i, struct hanoi_hint *hint);
+
+enum hanoi_init_response
+hanoi_solve_table_init (struct hanoi_solve_table *table, const uint32_t n_rods,
+                        const uint32_t n_disks);
+
+void
+hanoi_solve_table_free (struct hanoi_solve_table *table);
+
+uint64_t
+hanoi_solve_table_n_moves (const struct hanoi_solve_table *table);
+
+struct hanoi_move
+hanoi_solve_table_move (const struct hanoi_solve_table *table, uint64_t k);
+
+void
+hanoi_solve_table_iterator_init (struct hanoi_solve_table_iterator *it,
+                                 const struct hanoi_solve_table *table);
+
+bool
+hanoi_solve_table_iterator_next (struct hanoi_solve_table_iterator *it, struct hanoi_move *move);
+
+bool
+hanoi_solve_table (const struct hanoi_solve_table *table, hanoi_move_callback callback,
+                   void *data);
+
+#endif /* SOLVE_H */
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "stats.h"
+
+#define MAX_PATH_LEN 4096
+#define LINE_LEN 256
+
+struct hanoi_stats hanoi_stats_live;
+
+static char dump_path[MAX_PATH_LEN];
+
+static const char *counter_names[HANOI_STATS_N_COUNTERS] = {
+  [HANOI_STATS_MOVES] = "moves",
+  [HANOI_STATS_MOVES_REJECTED] = "moves_rejected",
+  [HANOI_STATS_RECORD_WRITES] = "record_writes",
+  [HANOI_STATS_RECORD_WRITE_BYTES] = "record_write_bytes",
+  [HANOI_STATS_RECORD_FINALIZES] = "record_finalizes",
+  [HANOI_STATS_FRAMES] = "frames",
+};
+
+static const char *histogram_names[HANOI_STATS_N_HISTOGRAMS] = {
+  [HANOI_STATS_RECORD_WRITE_NS] = "record_write_ns",
+  [HANOI_STATS_RECORD_FINALIZE_NS] = "record_finalize_ns",
+  [HANOI_STATS_KEY_TO_FRAME_NS] = "key_to_frame_ns",
+};
+
+const char *
+hanoi_stats_counter_name (const enum hanoi_stats_counter counter)
+{
+  return counter_names[counter];
+}
+
+const char *
+hanoi_stats_histogram_name (const enum hanoi_stats_histogram histogram)
+{
+  return histogram_names[histogram];
+}
+
+/**
+ * @brief Copies the current counters and histograms. Every value is read atomically but the copy
+ * is not a snapshot of a single moment.
+ *
+ * @param stats Target `struct hanoi_stats`.
+ */
+void
+hanoi_stats_read (struct hanoi_stats *stats)
+{
+  const uint64_t *live = (const uint64_t *)&hanoi_stats_live;
+  uint64_t *copy = (uint64_t *)stats;
+
+  for (size_t i = 0; i < sizeof (*stats) / sizeof (uint64_t); ++i)
+    {
+      copy[i] = __atomic_load_n (&live[i], __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Estimates a percentile of a histogram.
+ *
+ * @param histogram
+ * @param p Percentile, from 0 to 100.
+ * @return The upper bound of the bucket the percentile falls in, or 0 for an empty histogram.
+ */
+uint64_t
+hanoi_stats_percentile (const struct hanoi_histogram *histogram, const uint32_t p)
+{
+  uint64_t total = 0;
+
+  for (uint32_t i = 0; i < HANOI_STATS_N_BUCKETS; ++i)
+    {
+      total += histogram->buckets[i];
+    }
+
+  const uint64_t rank = (total * p + 99) / 100;
+  uint64_t seen = 0;
+
+  for (uint32_t i = 0; i < HANOI_STATS_N_BUCKETS; ++i)
+    {
+      seen += histogram->buckets[i];
+
+      if (seen >= rank && seen > 0)
+        {
+          return i == 0 ? 0 : i == HANOI_STATS_N_BUCKETS - 1 ? histogram->max : (1ull << i) - 1;
+        }
+    }
+
+  return 0;
+}
+
+/* The dump is made with nothing but these and `write`, so it is safe in a signal handler. */
+
+static size_t
+append_str (char *line, size_t len, const char *s)
+{
+  while (*s != '\0' && len < LINE_LEN)
+    {
+      line[len++] = *s++;
+    }
+
+  return len;
+}
+
+static size_t
+append_u64 (char *line, size_t len, uint64_t n)
+{
+  char digits[20];
+  int n_digits = 0;
+
+  do
+    {
+      digits[n_digits++] = '0' + n % 10;
+      n /= 10;
+    }
+  while (n > 0);
+
+  while (n_digits > 0 && len < LINE_LEN)
+    {
+      line[len++] = digits[--n_digits];
+    }
+
+  return len;
+}
+
+static bool
+write_line (const int fd, const char *line, const size_t len)
+{
+  size_t done = 0;
+
+  while (done < len)
+    {
+      const ssize_t n = write (fd, line + done, len - done);
+
+      if (n == -1 && errno != EINTR)
+        {
+          return false;
+        }
+      done += n > 0 ? n : 0;
+    }
+
+  return true;
+}
+
+/**
+ * @brief Writes the counters and histograms to `path` as text, one `name value` line per counter
+ * and one line per histogram with its count, sum, max, percentiles and the non-empty buckets as
+ * `le_<upper bound> <count>`. Safe to call from a signal handler.
+ *
+ * @param path
+ * @return true - The stats were written.
+ * @return false - Writing failed. Check `errno`.
+ */
+bool
+hanoi_stats_dump (const char *path)
+{
+  const int fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd == -1)
+    {
+      return false;
+    }
+
+  struct hanoi_stats stats;
+  char line[LINE_LEN + 1];
+  bool ok = true;
+
+  hanoi_stats_read (&stats);
+
+  for (int c = 0; ok && c < HANOI_STATS_N_COUNTERS; ++c)
+    {
+      size_t len = append_str (line, 0, counter_names[c]);
+      len = append_str (line, len, " ");
+      len = append_u64 (line, len, stats.counters[c]);
+      line[len++] = '\n';
+      ok = write_line (fd, line, len);
+    }
+
+  for (int h = 0; ok && h < HANOI_STATS_N_HISTOGRAMS; ++h)
+    {
+      const struct hanoi_histogram *histogram = &stats.histograms[h];
+      size_t len = append_str (line, 0, histogram_names[h]);
+
+      len = append_str (line, len, " count ");
+      len = append_u64 (line, len, histogram->count);
+      len = append_str (line, len, " sum ");
+      len = append_u64 (line, len, histogram->sum);
+      len = append_str (line, len, " max ");
+      len = append_u64 (line, len, histogram->max);
+      len = append_str (line, len, " p50 ");
+      len = append_u64 (line, len, hanoi_stats_percentile (histogram, 50));
+      len = append_str (line, len, " p90 ");
+      len = append_u64 (line, len, hanoi_stats_percentile (histogram, 90));
+      len = append_str (line, len, " p99 ");
+      len = append_u64 (line, len, hanoi_stats_percentile (histogram, 99));
+      ok = write_line (fd, line, len);
+
+      for (uint32_t i = 0; ok && i < HANOI_STATS_N_BUCKETS; ++i)
+        {
+          if (histogram->buckets[i] > 0)
+            {
+              len = append_str (line, 0, " le_");
+              len = append_u64 (line, len, i == 0 ? 0 : (1ull << i) - 1);
+              len = append_str (line, len, " ");
+              len = append_u64 (line, len, histogram->buckets[i]);
+              ok = write_line (fd, line, len);
+            }
+        }
+
+      ok = ok && write_line (fd, "\n", 1);
+    }
+
+  return close (fd) == 0 && ok;
+}
+
+static void
+dump_on_signal (int signum)
+{
+  const int error = errno;
+
+  (void)signum;
+  hanoi_stats_dump (dump_path);
+  errno = error;
+}
+
+static void
+dump_on_exit (void)
+{
+  hanoi_stats_dump (dump_path);
+}
+
+/**
+ * @brief Makes the process dump its stats to `path` when it gets `SIGUSR1` and when it exits, see
+ * `hanoi_stats_dump`.
+ *
+ * @param path
+ * @return true - The handlers were installed.
+ * @return false - `path` is too long or installing failed. Check `errno`.
+ */
+bool
+hanoi_stats_install (const char *path)
+{
+  if (strlen (path) >= sizeof (dump_path))
+    {
+      errno = ENAMETOOLONG;
+      return false;
+    }
+
+  strcpy (dump_path, path);
+
+  struct sigaction action;
+  memset (&action, 0, sizeof (action));
+  action.sa_handler = dump_on_signal;
+  action.sa_flags = SA_RESTART;
+  sigemptyset (&action.sa_mask);
+
+  return sigaction (SIGUSR1, &action, NULL) == 0 && atexit (dump_on_exit) == 0;
+}
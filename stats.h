@@ -0,0 +1,120 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Bucket 0 counts zeros, bucket i values in [2^(i - 1), 2^i). The last bucket takes the rest. */
+#define HANOI_STATS_N_BUCKETS 64
+
+enum hanoi_stats_counter
+{
+  HANOI_STATS_MOVES,
+  HANOI_STATS_MOVES_REJECTED,
+  HANOI_STATS_RECORD_WRITES,
+  HANOI_STATS_RECORD_WRITE_BYTES,
+  HANOI_STATS_RECORD_FINALIZES,
+  HANOI_STATS_FRAMES,
+  HANOI_STATS_N_COUNTERS,
+};
+
+enum hanoi_stats_histogram
+{
+  /* Writes of moves and the move count of a record, including the writes of the writer thread. */
+  HANOI_STATS_RECORD_WRITE_NS,
+  /* All of `hanoi_recorder_write_checksum`. */
+  HANOI_STATS_RECORD_FINALIZE_NS,
+  /* From a key being read in the game until the frame after it is on the terminal. */
+  HANOI_STATS_KEY_TO_FRAME_NS,
+  HANOI_STATS_N_HISTOGRAMS,
+};
+
+struct hanoi_histogram
+{
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+  uint64_t buckets[HANOI_STATS_N_BUCKETS];
+};
+
+/**
+ * Counters and latency histograms of the process. They are only updated when built with
+ * `HANOI_STATS` defined, see `HANOI_STATS_COUNT` and `HANOI_STATS_RECORD`.
+ */
+struct hanoi_stats
+{
+  uint64_t counters[HANOI_STATS_N_COUNTERS];
+  struct hanoi_histogram histograms[HANOI_STATS_N_HISTOGRAMS];
+};
+
+const char *
+hanoi_stats_counter_name (const enum hanoi_stats_counter counter);
+
+const char *
+hanoi_stats_histogram_name (const enum hanoi_stats_histogram histogram);
+
+void
+hanoi_stats_read (struct hanoi_stats *stats);
+
+uint64_t
+hanoi_stats_percentile (const struct hanoi_histogram *histogram, const uint32_t p);
+
+bool
+hanoi_stats_dump (const char *path);
+
+bool
+hanoi_stats_install (const char *path);
+
+#ifdef HANOI_STATS
+
+extern struct hanoi_stats hanoi_stats_live;
+
+static inline uint64_t
+hanoi_stats_now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline void
+hanoi_stats_count (const enum hanoi_stats_counter counter, const uint64_t n)
+{
+  __atomic_fetch_add (&hanoi_stats_live.counters[counter], n, __ATOMIC_RELAXED);
+}
+
+static inline void
+hanoi_stats_record (const enum hanoi_stats_histogram histogram, const uint64_t value)
+{
+  struct hanoi_histogram *h = &hanoi_stats_live.histograms[histogram];
+  const uint32_t bucket = value == 0 ? 0 : 64 - __builtin_clzll (value);
+  const uint32_t i = bucket < HANOI_STATS_N_BUCKETS ? bucket : HANOI_STATS_N_BUCKETS - 1;
+  uint64_t max = __atomic_load_n (&h->max, __ATOMIC_RELAXED);
+
+  __atomic_fetch_add (&h->count, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add (&h->sum, value, __ATOMIC_RELAXED);
+  __atomic_fetch_add (&h->buckets[i], 1, __ATOMIC_RELAXED);
+
+  while (value > max
+         && !__atomic_compare_exchange_n (&h->max, &max, value, true, __ATOMIC_RELAXED,
+                                          __ATOMIC_RELAXED))
+    {
+    }
+}
+
+#define HANOI_STATS_NOW() hanoi_stats_now ()
+#define HANOI_STATS_COUNT(counter, n) hanoi_stats_count (counter, n)
+#define HANOI_STATS_RECORD(histogram, value) hanoi_stats_record (histogram, value)
+
+#else
+
+/* Without `HANOI_STATS` the arguments are still evaluated, so the compiler sees them used. */
+#define HANOI_STATS_NOW() ((uint64_t)0)
+#define HANOI_STATS_COUNT(counter, n) ((void)(n))
+#define HANOI_STATS_RECORD(histogram, value) ((void)(value))
+
+#endif
+
+#endif /* STATS_H */
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "hanoi.h"
+#include "table.h"
+
+/**
+ * @brief Builds the transition table of a puzzle. A successful init must be freed using
+ * `hanoi_table_free`. The initial state, all disks on the first rod, is 0.
+ *
+ * @param table Target `struct hanoi_table`.
+ * @param n_rods Amount of rods in the puzzle. At least 2.
+ * @param n_disks Amount of disks in the puzzle.
+ * @return HANOI_INIT_OK - Init successful.
+ * @return HANOI_INIT_INVALID_N_RODS_VALUE - The value of `n_rods` was set to `HANOI_INCOMPLATE`.
+ * @return HANOI_INIT_UNSUPPORTED_SIZE - The table would have more than `HANOI_TABLE_MAX_ENTRIES`
+ * entries.
+ * @return HANOI_INIT_SYSTEM_ERROR - System failure during init. Check `errno`.
+ */
+enum hanoi_init_response
+hanoi_table_init (struct hanoi_table *table, const uint32_t n_rods, const uint32_t n_disks)
+{
+  if (n_rods == HANOI_INCOMPLETE)
+    {
+      return HANOI_INIT_INVALID_N_RODS_VALUE;
+    }
+
+  if (n_rods < 2 || n_disks == 0)
+    {
+      return HANOI_INIT_UNSUPPORTED_SIZE;
+    }
+
+  const uint64_t n_moves = (uint64_t)n_rods * n_rods;
+  uint64_t n_states = 1;
+  uint32_t powers[n_disks];
+
+  for (uint32_t d = 0; d < n_disks; ++d)
+    {
+      if (n_states * n_moves > HANOI_TABLE_MAX_ENTRIES)
+        {
+          return HANOI_INIT_UNSUPPORTED_SIZE;
+        }
+
+      powers[d] = n_states;
+      n_states *= n_rods;
+    }
+
+  if (n_states * n_moves > HANOI_TABLE_MAX_ENTRIES)
+    {
+      return HANOI_INIT_UNSUPPORTED_SIZE;
+    }
+
+  table->next = malloc (sizeof (table->next[0]) * n_states * n_moves);
+  if (table->next == NULL)
+    {
+      return HANOI_INIT_SYSTEM_ERROR;
+    }
+
+  table->n_rods = n_rods;
+  table->n_disks = n_disks;
+  table->n_states = n_states;
+  table->complete_step = (n_states - 1) / (n_rods - 1);
+
+  uint32_t tops[n_rods];
+
+  for (uint32_t s = 0; s < n_states; ++s)
+    {
+      for (uint32_t i = 0; i < n_rods; ++i)
+        {
+          tops[i] = 0;
+        }
+
+      /* Walking from the smallest disk, the first disk found on a rod is its top disk. */
+      for (uint32_t d = 1, r = s; d <= n_disks; ++d, r /= n_rods)
+        {
+          if (tops[r % n_rods] == 0)
+            {
+              tops[r % n_rods] = d;
+            }
+        }
+
+      uint32_t *next = table->next + s * n_moves;
+
+      for (uint32_t src_i = 0; src_i < n_rods; ++src_i)
+        {
+          for (uint32_t des_i = 0; des_i < n_rods; ++des_i)
+            {
+              const uint32_t src = tops[src_i];
+              const uint32_t des = tops[des_i];
+
+              if (src != 0 && (des == 0 || src < des))
+                {
+                  next[src_i * n_rods + des_i]
+                      = s + des_i * powers[src - 1] - src_i * powers[src - 1];
+                }
+              else
+                {
+                  next[src_i * n_rods + des_i] = HANOI_TABLE_ILLEGAL;
+                }
+            }
+        }
+    }
+
+  return HANOI_INIT_OK;
+}
+
+void
+hanoi_table_free (struct hanoi_table *table)
+{
+  free (table->next);
+}
+
+/**
+ * @brief Moves a disk to a new rod with a single table lookup.
+ *
+ * @param table
+ * @param state The state the move should take place in.
+ * @param src_i Index of the source rod.
+ * @param des_i Index of the destination rod.
+ * @return true - `state` was updated.
+ * @return false - `state` did not update.
+ */
+bool
+hanoi_table_move (const struct hanoi_table *table, uint32_t *state, const uint32_t src_i,
+                  const uint32_t des_i)
+{
+  const uint32_t next = table->next[(*state * table->n_rods + src_i) * table->n_rods + des_i];
+
+  if (next == HANOI_TABLE_ILLEGAL)
+    {
+      return false;
+    }
+
+  *state = next;
+  return true;
+}
+
+/**
+ * @brief Checks if a state is completed. See `hanoi_complete`.
+ *
+ * @param table
+ * @param state
+ * @return uint32_t The index of the rod where all disks resides or `HANOI_INCOMPLETE` if the state
+ * is not complete.
+ */
+uint32_t
+hanoi_table_complete (const struct hanoi_table *table, const uint32_t state)
+{
+  /* Complete states have every digit equal, which makes them multiples of 11...1 in base n_rods. */
+  return state % table->complete_step == 0 ? state / table->complete_step : HANOI_INCOMPLETE;
+}
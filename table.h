@@ -0,0 +1,40 @@
+
+#ifndef TABLE_H
+#define TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hanoi.h"
+
+#define HANOI_TABLE_MAX_ENTRIES ((uint64_t)1 << 24)
+#define HANOI_TABLE_ILLEGAL ((uint32_t)-1)
+
+/**
+ * Precomputed transitions of every state of a small puzzle. States are the ranks of `hanoi_rank`
+ * and `next[(state * n_rods + src_i) * n_rods + des_i]` is the state after the move, or
+ * `HANOI_TABLE_ILLEGAL`.
+ */
+struct hanoi_table
+{
+  uint32_t n_rods;
+  uint32_t n_disks;
+  uint32_t n_states;
+  uint32_t complete_step;
+  uint32_t *next;
+};
+
+enum hanoi_init_response
+hanoi_table_init (struct hanoi_table *table, const uint32_t n_rods, const uint32_t n_disks);
+
+void
+hanoi_table_free (struct hanoi_table *table);
+
+bool
+hanoi_table_move (const struct hanoi_table *table, uint32_t *state, const uint32_t src_i,
+                  const uint32_t des_i);
+
+uint32_t
+hanoi_table_complete (const struct hanoi_table *table, const uint32_t state);
+
+#endif /* TABLE_H */
\ No newline at end of file
@@ -0,0 +1,475 @@
+#include <dirent.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hanoi.h"
+#include "packed.h"
+#include "record.h"
+#include "segment.h"
+#include "solve.h"
+
+#define error(...)                                                                                 \
+  {                                                                                                \
+    fprintf (stderr, "ERROR %s:%d - ", __FILE__, __LINE__);                                        \
+    fprintf (stderr, __VA_ARGS__);                                                                 \
+  }
+
+/* Fails the current case with the condition that did not hold. */
+#define CHECK(condition)                                                                           \
+  if (!(condition))                                                                                \
+    {                                                                                              \
+      fprintf (stderr, "FAIL %s:%d - %s\n", __FILE__, __LINE__, #condition);                       \
+      return false;                                                                                \
+    }
+
+#define N_MOVES 3000
+#define N_SCRAMBLE 100
+#define N_SEEKS 16
+
+/**
+ * One way of writing a record. Every case is written, read back and checked against the moves
+ * it was given.
+ */
+struct test_case
+{
+  uint16_t version;
+  uint32_t keyframe_interval;
+  enum hanoi_record_storage storage;
+  /* Write through a writer thread with this policy, or synchronously if `async` is false. */
+  bool async;
+  enum hanoi_flush_policy flush;
+  /* Start the recorder from a `struct hanoi_packed` instead of a puzzle. */
+  bool packed;
+  bool finish;
+  uint32_t n_rods;
+  uint32_t n_disks;
+};
+
+/**
+ * Moves given to the recorder and the puzzle the record starts from.
+ */
+struct game
+{
+  struct hanoi_record_move moves[N_MOVES];
+  struct hanoi_move scramble[N_SCRAMBLE];
+  uint32_t n_scramble;
+};
+
+static uint32_t n_failed = 0;
+
+static bool
+same_state (const struct hanoi_puzzle *a, const struct hanoi_puzzle *b)
+{
+  for (uint32_t i = 0; i < a->n_rods; ++i)
+    {
+      if (a->heights[i] != b->heights[i])
+        {
+          return false;
+        }
+
+      for (uint32_t j = 0; j < a->n_disks; ++j)
+        {
+          if (a->state[i][j] != b->state[i][j])
+            {
+              return false;
+            }
+        }
+    }
+
+  return hanoi_complete (a) == hanoi_complete (b);
+}
+
+/**
+ * @brief Sets `pzl` to the start of `game` followed by its first `k` moves.
+ */
+static void
+play (struct hanoi_puzzle *pzl, const struct game *game, const uint64_t k)
+{
+  const uint32_t n_rods = pzl->n_rods;
+  const uint32_t n_disks = pzl->n_disks;
+
+  hanoi_free (pzl);
+  hanoi_init (pzl, n_rods, n_disks);
+
+  for (uint32_t i = 0; i < game->n_scramble; ++i)
+    {
+      hanoi_move (pzl, game->scramble[i].src_i, game->scramble[i].des_i);
+    }
+  for (uint64_t i = 0; i < k; ++i)
+    {
+      hanoi_move (pzl, game->moves[i].src_i, game->moves[i].des_i);
+    }
+}
+
+/**
+ * @brief Makes a game of random legal moves. Durations mostly grow but sometimes go back, which
+ * the compact encoding has to take as a negative delta.
+ */
+static void
+make_game (struct game *game, struct hanoi_puzzle *pzl)
+{
+  game->n_scramble = 0;
+
+  while (game->n_scramble < N_SCRAMBLE)
+    {
+      const uint32_t src_i = rand () % pzl->n_rods;
+      const uint32_t des_i = rand () % pzl->n_rods;
+
+      if (hanoi_move (pzl, src_i, des_i))
+        {
+          game->scramble[game->n_scramble++] = (struct hanoi_move){ src_i, des_i };
+        }
+    }
+
+  struct hanoi_puzzle copy;
+  uint64_t duration = 0;
+  uint32_t n = 0;
+
+  if (hanoi_init (&copy, pzl->n_rods, pzl->n_disks) != HANOI_INIT_OK)
+    {
+      return;
+    }
+  play (&copy, game, 0);
+
+  while (n < N_MOVES)
+    {
+      const uint32_t src_i = rand () % pzl->n_rods;
+      const uint32_t des_i = rand () % pzl->n_rods;
+
+      if (hanoi_move (&copy, src_i, des_i))
+        {
+          duration = rand () % 16 == 0 && duration > 100 ? duration - rand () % 100
+                                                          : duration + rand () % 1000;
+          game->moves[n++] = (struct hanoi_record_move){ src_i, des_i, duration };
+        }
+    }
+
+  hanoi_free (&copy);
+}
+
+static bool
+write_record (const struct test_case *test, const struct game *game, struct hanoi_puzzle *start,
+              char **path, uint64_t *id)
+{
+  struct hanoi_recorder recorder;
+
+  if (test->packed)
+    {
+      struct hanoi_packed pk;
+
+      CHECK (hanoi_packed_init (&pk, test->n_rods, test->n_disks) == HANOI_INIT_OK);
+      hanoi_packed_from_puzzle (&pk, start);
+
+      const bool ok = hanoi_new_recorder_packed (&recorder, &pk, "test");
+      hanoi_packed_free (&pk);
+      CHECK (ok);
+    }
+  else
+    {
+      CHECK (hanoi_new_recorder (&recorder, start, "test"));
+    }
+
+  if (test->async)
+    {
+      const struct hanoi_recorder_options options = {
+        .flush = test->flush,
+        .interval_ms = 1,
+        .sync = false,
+        .ring_size = 64,
+      };
+
+      CHECK (hanoi_recorder_start_async (&recorder, &options));
+    }
+
+  for (uint32_t k = 0; k < N_MOVES; ++k)
+    {
+      CHECK (hanoi_recorder_push_move (&recorder, game->moves[k].src_i, game->moves[k].des_i,
+                                       game->moves[k].duration));
+    }
+
+  if (test->finish)
+    {
+      CHECK (hanoi_recorder_write_checksum (&recorder));
+    }
+
+  *path = strdup (recorder.path);
+  *id = recorder.id;
+  hanoi_free_recorder (&recorder);
+  CHECK (*path != NULL);
+
+  return true;
+}
+
+/**
+ * @brief Reads a record back the ways there are and checks it against the game it was made from.
+ */
+static bool
+check_record (const struct test_case *test, const struct game *game,
+              const struct hanoi_record *record, struct hanoi_puzzle *pzl, struct hanoi_puzzle *ref)
+{
+  CHECK (record->version == test->version);
+  CHECK (hanoi_record_n_rods (record) == test->n_rods);
+  CHECK (hanoi_record_n_disks (record) == test->n_disks);
+  CHECK (hanoi_record_n_moves (record) == N_MOVES);
+  CHECK (strncmp (hanoi_record_username (record), "test", HANOI_RECORD_MAX_USERNAME_LEN) == 0);
+  CHECK (hanoi_record_finished (record) == test->finish);
+  CHECK (hanoi_record_checksum_valid (record) == test->finish);
+
+  /* Keyframes are only written when the record is finished. */
+  const uint64_t n_keyframes
+      = test->finish && test->keyframe_interval > 0 ? N_MOVES / test->keyframe_interval : 0;
+  CHECK (record->n_keyframes == n_keyframes);
+  CHECK (hanoi_record_keyframes_valid (record));
+
+  struct hanoi_record_iterator it;
+  struct hanoi_record_move move;
+
+  hanoi_record_iterator_init (&it, record);
+  for (uint32_t k = 0; k < N_MOVES; ++k)
+    {
+      CHECK (hanoi_record_iterator_next (&it, &move));
+      CHECK (move.src_i == game->moves[k].src_i && move.des_i == game->moves[k].des_i
+             && move.duration == game->moves[k].duration);
+    }
+  CHECK (!hanoi_record_iterator_next (&it, &move) && it.remaining == 0);
+
+  uint64_t n_played;
+
+  play (ref, game, N_MOVES);
+  CHECK (hanoi_record_replay (record, pzl, &n_played) == HANOI_REPLAY_OK);
+  CHECK (n_played == N_MOVES && same_state (pzl, ref));
+
+  for (uint32_t s = 0; s < N_SEEKS; ++s)
+    {
+      const uint64_t k = s == 0                             ? 0
+                         : s == 1                           ? N_MOVES
+                         : s == 2 && test->keyframe_interval ? test->keyframe_interval
+                                                             : (uint64_t)rand () % (N_MOVES + 1);
+
+      play (ref, game, k);
+      CHECK (hanoi_record_seek (record, k, pzl, &it));
+      CHECK (same_state (pzl, ref));
+
+      if (k < N_MOVES)
+        {
+          CHECK (hanoi_record_iterator_next (&it, &move));
+          CHECK (move.src_i == game->moves[k].src_i && move.des_i == game->moves[k].des_i
+                 && move.duration == game->moves[k].duration);
+        }
+      else
+        {
+          CHECK (!hanoi_record_iterator_next (&it, &move));
+        }
+    }
+  CHECK (!hanoi_record_seek (record, N_MOVES + 1, pzl, &it));
+
+  return true;
+}
+
+/**
+ * @brief Flips bits of a finished record one at a time and checks that the checksum no longer
+ * matches. Bits that change what the view takes as the record may make it fail to open instead.
+ */
+static bool
+check_tampering (const struct hanoi_record *record)
+{
+  const size_t size = record->size + (record->keyframes != NULL
+                                          ? record->n_keyframes * record->keyframe_size + 32
+                                          : 0);
+  uint64_t *copy = malloc ((size + 7) / 8 * 8);
+
+  CHECK (copy != NULL);
+  memcpy (copy, record->data, size);
+
+  uint8_t *bytes = (uint8_t *)copy;
+  bool ok = true;
+
+  /* Every byte of the header and of the keyframe footer, about 512 spread over the rest. */
+  const size_t stride = size / 512 > 0 ? size / 512 : 1;
+
+  for (size_t i = 0; ok && i < size; i += i < 256 || i + 256 >= size ? 1 : stride)
+    {
+      const uint8_t bit = 1 << (i % 8);
+      struct hanoi_record view;
+
+      bytes[i] ^= bit;
+      ok = !hanoi_record_view (&view, copy, size) || !hanoi_record_checksum_valid (&view);
+      bytes[i] ^= bit;
+
+      if (!ok)
+        {
+          fprintf (stderr, "FAIL %s:%d - flipping a bit of byte %zu went unnoticed\n", __FILE__,
+                   __LINE__, i);
+        }
+    }
+
+  free (copy);
+
+  return ok;
+}
+
+static bool
+run_case (const struct test_case *test)
+{
+  struct hanoi_puzzle start;
+  struct hanoi_puzzle pzl;
+  struct hanoi_puzzle ref;
+  struct game *game = malloc (sizeof (*game));
+  char *path = NULL;
+  uint64_t id;
+  bool ok = false;
+
+  if (game == NULL || hanoi_init (&start, test->n_rods, test->n_disks) != HANOI_INIT_OK)
+    {
+      free (game);
+      return false;
+    }
+  hanoi_init (&pzl, test->n_rods, test->n_disks);
+  hanoi_init (&ref, test->n_rods, test->n_disks);
+
+  hanoi_set_record_version (test->version);
+  hanoi_set_record_keyframes (test->keyframe_interval);
+  hanoi_set_record_storage (test->storage, 0);
+
+  make_game (game, &start);
+
+  if (write_record (test, game, &start, &path, &id))
+    {
+      if (test->storage == HANOI_RECORD_STORAGE_SEGMENTS)
+        {
+          struct hanoi_segment segment;
+          struct hanoi_record record;
+
+          if (hanoi_segment_open (&segment, path))
+            {
+              ok = hanoi_segment_record (&segment, (uint32_t)id, &record)
+                   && check_record (test, game, &record, &pzl, &ref)
+                   && (!test->finish || check_tampering (&record));
+              hanoi_segment_close (&segment);
+            }
+        }
+      else
+        {
+          struct hanoi_record_file file;
+
+          if (hanoi_record_open (&file, path))
+            {
+              ok = check_record (test, game, &file.record, &pzl, &ref)
+                   && (!test->finish || check_tampering (&file.record));
+              hanoi_record_close (&file);
+            }
+          remove (path);
+        }
+    }
+
+  free (path);
+  free (game);
+  hanoi_free (&start);
+  hanoi_free (&pzl);
+  hanoi_free (&ref);
+
+  return ok;
+}
+
+/**
+ * @brief Removes the records directory and everything the cases left in it.
+ */
+static void
+remove_directory (const char *directory)
+{
+  DIR *dir = opendir (directory);
+
+  if (dir != NULL)
+    {
+      for (struct dirent *dirent; (dirent = readdir (dir)) != NULL;)
+        {
+          char path[4096];
+
+          if (strcmp (dirent->d_name, ".") != 0 && strcmp (dirent->d_name, "..") != 0)
+            {
+              snprintf (path, sizeof (path), "%s/%s", directory, dirent->d_name);
+              remove (path);
+            }
+        }
+      closedir (dir);
+    }
+
+  rmdir (directory);
+}
+
+int
+main (void)
+{
+  char directory[] = "/tmp/hanoi-test-XXXXXX";
+
+  if (mkdtemp (directory) == NULL)
+    {
+      error ("%s\n", strerror (errno));
+      return 1;
+    }
+
+  static const uint16_t versions[] = { HANOI_RECORD_VERSION_FIXED, HANOI_RECORD_VERSION_COMPACT };
+  static const uint32_t intervals[] = { 0, 1, 64 };
+  /* Up to 16 rods the compact encoding packs a move in a byte, with more it uses varints. */
+  static const uint32_t sizes[][2] = { { 3, 5 }, { 4, 10 }, { 20, 40 } };
+  /* Synchronous writes, then the writer thread with every flush policy. */
+  static const char *modes[]
+      = { "sync", "async per move", "async interval", "async on completion" };
+  static const enum hanoi_flush_policy flushes[] = {
+    HANOI_FLUSH_PER_MOVE,
+    HANOI_FLUSH_PER_MOVE,
+    HANOI_FLUSH_INTERVAL,
+    HANOI_FLUSH_ON_COMPLETION,
+  };
+  uint32_t n_cases = 0;
+
+  srand (1);
+  hanoi_set_records_directory (directory);
+
+  for (size_t v = 0; v < sizeof (versions) / sizeof (versions[0]); ++v)
+    {
+      for (size_t i = 0; i < sizeof (intervals) / sizeof (intervals[0]); ++i)
+        {
+          /* The low two bits pick one of `modes`, the others storage, start and finishing. */
+          for (uint32_t variant = 0; variant < 32; ++variant)
+            {
+              const size_t s = variant % (sizeof (sizes) / sizeof (sizes[0]));
+              const uint32_t mode = variant % 4;
+              const struct test_case test = {
+                .version = versions[v],
+                .keyframe_interval = intervals[i],
+                .storage = variant & 4 ? HANOI_RECORD_STORAGE_SEGMENTS : HANOI_RECORD_STORAGE_FILES,
+                .async = mode > 0,
+                .flush = flushes[mode],
+                .packed = variant & 8,
+                .finish = variant & 16,
+                .n_rods = sizes[s][0],
+                .n_disks = sizes[s][1],
+              };
+
+              ++n_cases;
+
+              if (!run_case (&test))
+                {
+                  ++n_failed;
+                  fprintf (stderr, "FAIL version %u, keyframes %u, %s, %s, %s, %s, %ux%u\n",
+                           test.version, test.keyframe_interval,
+                           test.storage == HANOI_RECORD_STORAGE_SEGMENTS ? "segments" : "files",
+                           modes[mode], test.packed ? "packed" : "puzzle",
+                           test.finish ? "finished" : "unfinished", test.n_rods, test.n_disks);
+                }
+            }
+        }
+    }
+
+  remove_directory (directory);
+
+  printf ("%u of %u record cases passed\n", n_cases - n_failed, n_cases);
+
+  return n_failed > 0 ? 1 : 0;
+}
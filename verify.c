@@ -0,0 +1,328 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "archive.h"
+#include "hanoi.h"
+#include "record.h"
+
+#define error(...)                                                                                 \
+  {                                                                                                \
+    fprintf (stderr, "ERROR %s:%d - ", __FILE__, __LINE__);                                        \
+    fprintf (stderr, __VA_ARGS__);                                                                 \
+  }
+
+/**
+ * Every game of the archive is a job.
+ */
+struct verifier
+{
+  struct hanoi_archive archive;
+  struct worker *workers;
+  uint32_t n_workers;
+};
+
+/**
+ * Every worker starts with its own slice of the jobs and takes from the slices of the others
+ * once its own is done.
+ */
+struct worker
+{
+  struct verifier *verifier;
+  pthread_t thread;
+  size_t next;
+  size_t end;
+  struct hanoi_puzzle pzl;
+  bool has_pzl;
+  uint64_t games;
+  uint64_t bytes;
+  uint64_t unfinished;
+  uint64_t failures;
+};
+
+static const char *
+replay_failure (const enum hanoi_replay_response response)
+{
+  switch (response)
+    {
+    case HANOI_REPLAY_OK:
+      return NULL;
+    case HANOI_REPLAY_SIZE_MISMATCH:
+      return "size mismatch";
+    case HANOI_REPLAY_ILLEGAL_STATE:
+      return "illegal initial state";
+    case HANOI_REPLAY_ILLEGAL_MOVE:
+      return "illegal move";
+    case HANOI_REPLAY_TRUNCATED:
+      return "truncated move log";
+    }
+
+  return "unknown replay failure";
+}
+
+/**
+ * @brief Checks the checksum of a record, replays it from its snapshot, checks its keyframes
+ * against the replay and checks that it ends complete. Games that were never finished have
+ * nothing to check and are only counted.
+ *
+ * @return NULL if the record is valid or unfinished, otherwise why it is not valid.
+ */
+static const char *
+verify_record (struct worker *worker, const struct hanoi_record *record)
+{
+  if (!hanoi_record_finished (record))
+    {
+      ++worker->unfinished;
+      return NULL;
+    }
+
+  if (!hanoi_record_checksum_valid (record))
+    {
+      return "checksum mismatch";
+    }
+
+  const uint32_t n_rods = hanoi_record_n_rods (record);
+  const uint32_t n_disks = hanoi_record_n_disks (record);
+
+  if (!worker->has_pzl || worker->pzl.n_rods != n_rods || worker->pzl.n_disks != n_disks)
+    {
+      if (worker->has_pzl)
+        {
+          hanoi_free (&worker->pzl);
+        }
+
+      worker->has_pzl = hanoi_init (&worker->pzl, n_rods, n_disks) == HANOI_INIT_OK;
+      if (!worker->has_pzl)
+        {
+          return "unsupported size";
+        }
+    }
+
+  uint64_t n_played;
+  const char *failure = replay_failure (hanoi_record_replay (record, &worker->pzl, &n_played));
+
+  if (failure != NULL)
+    {
+      return failure;
+    }
+
+  if (!hanoi_record_keyframes_valid (record))
+    {
+      return "keyframe mismatch";
+    }
+
+  if (hanoi_complete (&worker->pzl) == HANOI_INCOMPLETE)
+    {
+      return "not complete";
+    }
+
+  return NULL;
+}
+
+static void
+run_job (struct worker *worker, const size_t job)
+{
+  const struct hanoi_archive *archive = &worker->verifier->archive;
+  const struct hanoi_archive_game *game = &archive->games[job];
+  const struct hanoi_archive_source *source = &archive->sources[game->source];
+  struct hanoi_archive_record record;
+  const char *failure;
+
+  if (!hanoi_archive_record (archive, job, &record))
+    {
+      failure = game->game == HANOI_ARCHIVE_WHOLE_FILE ? "unreadable record" : "bad index entry";
+    }
+  else
+    {
+      worker->bytes += record.size;
+      failure = verify_record (worker, &record.record);
+      hanoi_archive_record_close (&record);
+    }
+
+  ++worker->games;
+
+  if (failure != NULL)
+    {
+      ++worker->failures;
+
+      if (game->game == HANOI_ARCHIVE_WHOLE_FILE)
+        {
+          printf ("FAIL %s: %s\n", source->path, failure);
+        }
+      else
+        {
+          printf ("FAIL %s#%u: %s\n", source->path, game->game, failure);
+        }
+    }
+}
+
+/**
+ * @brief Takes the next job of `worker`, or of another worker if it has none left.
+ */
+static bool
+claim_job (struct worker *worker, size_t *job)
+{
+  const struct verifier *verifier = worker->verifier;
+  const uint32_t self = worker - verifier->workers;
+
+  for (uint32_t k = 0; k < verifier->n_workers; ++k)
+    {
+      struct worker *victim = &verifier->workers[(self + k) % verifier->n_workers];
+
+      while (__atomic_load_n (&victim->next, __ATOMIC_RELAXED) < victim->end)
+        {
+          *job = __atomic_fetch_add (&victim->next, 1, __ATOMIC_RELAXED);
+
+          if (*job < victim->end)
+            {
+              return true;
+            }
+        }
+    }
+
+  return false;
+}
+
+static void *
+run_worker (void *arg)
+{
+  struct worker *worker = arg;
+  size_t job;
+
+  while (claim_job (worker, &job))
+    {
+      run_job (worker, job);
+    }
+
+  if (worker->has_pzl)
+    {
+      hanoi_free (&worker->pzl);
+    }
+
+  return NULL;
+}
+
+static void
+print_help (const char *program)
+{
+  printf ("usage: %s\n", program);
+  printf ("    [ --threads=<n> ]\n");
+  printf ("    [ --help ]\n");
+  printf ("    <records directory | .hanoi-segment | .hanoi-puzzle>...\n");
+}
+
+int
+main (int argc, char **argv)
+{
+  struct verifier verifier = { 0 };
+  uint32_t n_threads = 0;
+  bool ok = argc > 1;
+
+  for (int i = 1; ok && i < argc; ++i)
+    {
+      if (sscanf (argv[i], "--threads=%u", &n_threads) == 1)
+        {
+        }
+      else if (strcmp (argv[i], "--help") == 0)
+        {
+          print_help (argv[0]);
+          return 0;
+        }
+      else if (!hanoi_archive_add (&verifier.archive, argv[i]))
+        {
+          error ("%s: %s\n", argv[i], strerror (errno));
+          ok = false;
+        }
+    }
+
+  if (n_threads == 0)
+    {
+      const long n = sysconf (_SC_NPROCESSORS_ONLN);
+      n_threads = n > 0 ? n : 1;
+    }
+
+  verifier.workers = ok ? calloc (n_threads, sizeof (verifier.workers[0])) : NULL;
+
+  if (verifier.workers == NULL)
+    {
+      if (ok)
+        {
+          error ("%s\n", strerror (errno));
+        }
+      else
+        {
+          print_help (argv[0]);
+        }
+
+      hanoi_archive_free (&verifier.archive);
+      return 1;
+    }
+
+  verifier.n_workers = n_threads;
+
+  for (uint32_t i = 0; i < n_threads; ++i)
+    {
+      verifier.workers[i].verifier = &verifier;
+      verifier.workers[i].next = verifier.archive.n_games * i / n_threads;
+      verifier.workers[i].end = verifier.archive.n_games * (i + 1) / n_threads;
+    }
+
+  struct timespec start;
+  struct timespec stop;
+  clock_gettime (CLOCK_MONOTONIC, &start);
+
+  /* The first worker is the main thread. A worker that cannot start leaves its jobs to the rest. */
+  uint32_t n_started = 1;
+  for (; n_started < n_threads; ++n_started)
+    {
+      if (pthread_create (&verifier.workers[n_started].thread, NULL, run_worker,
+                          &verifier.workers[n_started])
+          != 0)
+        {
+          break;
+        }
+    }
+
+  run_worker (&verifier.workers[0]);
+
+  for (uint32_t i = 1; i < n_started; ++i)
+    {
+      pthread_join (verifier.workers[i].thread, NULL);
+    }
+
+  clock_gettime (CLOCK_MONOTONIC, &stop);
+
+  uint64_t games = 0;
+  uint64_t bytes = 0;
+  uint64_t unfinished = 0;
+  uint64_t failures = 0;
+
+  for (uint32_t i = 0; i < n_threads; ++i)
+    {
+      games += verifier.workers[i].games;
+      bytes += verifier.workers[i].bytes;
+      unfinished += verifier.workers[i].unfinished;
+      failures += verifier.workers[i].failures;
+    }
+
+  const double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+  const double rate = seconds > 0 ? 1 / seconds : 0;
+
+  printf ("%zu files, %lu games, %lu bytes in %.3f s with %u threads\n",
+          verifier.archive.n_sources, (unsigned long)games, (unsigned long)bytes, seconds,
+          n_started);
+  printf ("%.0f files/s, %.0f games/s, %.0f bytes/s\n", verifier.archive.n_sources * rate,
+          games * rate, bytes * rate);
+  printf ("%lu unfinished, %lu failures\n", (unsigned long)unfinished, (unsigned long)failures);
+
+  hanoi_archive_free (&verifier.archive);
+  free (verifier.workers);
+
+  return failures > 0 ? 1 : 0;
+}